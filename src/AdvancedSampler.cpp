@@ -6,6 +6,89 @@
 #include "samplerate.h"
 #include "AudioClip.hpp"
 #include "dsp/Antipop.hpp"
+#include "dsp/LoopSeam.hpp"
+#include "dsp/Wavetable.hpp"
+#include "dsp/StateVariableFilter.hpp"
+#include "GrainEngine.hpp"
+#include "TimeStretch.hpp"
+#include "AnalysisWorker.hpp"
+#include "KeyMap.hpp"
+#include "ClipGroups.hpp"
+#include "SliceVoice.hpp"
+#include "dsp/OnsetDetector.hpp"
+#include "dsp/TempoEstimator.hpp"
+#include "dsp/PitchDetector.hpp"
+#include "dsp/PreRoll.hpp"
+#include "ClipIndex.hpp"
+#include "ClipSlots.hpp"
+#include "Looper.hpp"
+
+enum QualityTiers {
+    ECO_QUALITY,
+    NORMAL_QUALITY,
+    HIGH_QUALITY,
+    NUM_QUALITY_TIERS
+};
+
+// Interpolation, control rate, mipmaps and display refresh for each tier.
+struct QualityTier {
+    const char *label;
+    Interpolations interpolation;
+    int control_rate;
+    bool mipmaps;
+    float display_rate;
+};
+
+static const QualityTier quality_tiers_[NUM_QUALITY_TIERS] = {
+    //  Label     Interpolation  Control rate  Mipmaps  Display rate
+    {   "Eco",    LINEAR,        64,           false,   15.f },
+    {   "Normal", HERMITE,       16,           true,    30.f },
+    {   "High",   HERMITE,       4,            true,    60.f },
+};
+
+enum PlayModes {
+    SAMPLER_MODE,
+    GRANULAR_MODE,
+    STRETCH_MODE,
+    WAVETABLE_MODE,
+    SCRUB_MODE,
+    NUM_PLAY_MODES
+};
+
+enum LoopModes {
+    FORWARD_LOOP,
+    REVERSE_LOOP,
+    PINGPONG_LOOP,
+    NUM_LOOP_MODES
+};
+
+enum SliceModes {
+    NO_SLICES,
+    EQUAL_SLICES,
+    TRANSIENT_SLICES,
+    NUM_SLICE_MODES
+};
+
+enum SliceTriggerModes {
+    NO_SLICE_TRIGGER,
+    GATE_SLICE_TRIGGER,
+    CV_SLICE_TRIGGER,
+    NUM_SLICE_TRIGGER_MODES
+};
+
+enum TuneInputModes {
+    VOCT_TUNE_INPUT,
+    AUDIO_RATE_TUNE_INPUT,
+    LINEAR_FM_TUNE_INPUT,
+    NUM_TUNE_INPUT_MODES
+};
+
+enum NormaliseModes {
+    NO_NORMALISE,
+    PEAK_NORMALISE,
+    LOUDNESS_NORMALISE,
+    NUM_NORMALISE_MODES
+};
 
 struct AdvancedSampler : Module {
     enum ParamIds {
@@ -20,6 +103,18 @@ struct AdvancedSampler : Module {
         LOOP_PARAM,
         PLAY_PARAM,
         REC_PARAM,
+
+        GRAIN_DENSITY_PARAM,
+        GRAIN_SPRAY_PARAM,
+        STRETCH_PARAM,
+        FM_DEPTH_PARAM,
+        FILTER_CUTOFF_PARAM,
+        FILTER_RESONANCE_PARAM,
+        FILTER_ENV_PARAM,
+        SCRUB_SMOOTH_PARAM,
+        LOOPER_FEEDBACK_PARAM,
+        ARM_THRESHOLD_PARAM,
+        PRE_ROLL_PARAM,
         NUM_PARAMS
     };
 
@@ -53,26 +148,108 @@ struct AdvancedSampler : Module {
 
     double phase_ = 0;
     bool playing_ = false;
-    bool low_cpu_ = false;
+    QualityTiers quality_ = NORMAL_QUALITY;
+    bool use_mipmaps_ = true;
+    float ui_update_time_ = UI_update_time;
     bool looping_ = false;
     bool recording_ = false;
+
+    // Armed recording. REC arms, the input crossing the threshold starts the
+    // recording with the pre-roll in front.
+    static const int MAX_PRE_ROLL_MS = 500;
+    bool arm_recording_ = false;
+    bool armed_ = false;
+    bool record_pending_ = false;  // REC pressed before the first spare was ready.
+    float arm_threshold_ = 0;
+    int pre_roll_samples_ = 0;
+    PreRoll pre_roll_;
     bool hold_envelope_ = false;
     bool exponential_start_end_ = false;
-    bool slice_ = false;
+    bool snap_zero_crossings_ = false;
+    bool keymap_ = false;
+    bool clip_groups_ = false;
+    bool morph_ = false;
+    bool looper_mode_ = false;  // REC drives the looper instead of replacing the clip.
+    FilterModes filter_mode_ = NO_FILTER;
+    int sync_beats_ = 0;  // Loop length in clock beats. 0 is off, -1 fits the detected tempo.
+    SliceModes slice_mode_ = NO_SLICES;
+    SliceTriggerModes slice_trigger_mode_ = NO_SLICE_TRIGGER;
+    NormaliseModes normalise_mode_ = NO_NORMALISE;
+    // Normalisation gain, ramped over each control period like the increment.
+    static constexpr float MAX_CLIP_GAIN = 15.85f;  // +24dB.
+    float clip_gain_ = 1.0f;
+    float clip_gain_step_ = 0;
     int slice_division_ = 16;
+    TuneInputModes tune_input_mode_ = VOCT_TUNE_INPUT;
+    PlayModes play_mode_ = SAMPLER_MODE;
+    LoopModes loop_mode_ = FORWARD_LOOP;
+    bool ping_pong_reversed_ = false;
     Interpolations interpolation_mode_ = HERMITE;
 
+    // Control rate values. Updated every control_divider_ samples.
+    dsp::ClockDivider control_divider_;
+    int clip_index_ = 0;
+    float start_phase_ = 0;
+    float end_phase_ = 1;
+    float increment_scale_ = 0;
+    float tune_offset_ = 0;
+    bool morph_active_ = false;
+    int morph_clip_ = 0;
+    float morph_mix_ = 0;
+    double increment_ = 0;
+    double increment_step_ = 0;
+    double increment_target_ = 0;
+    double voice_increment_ = 0;  // Slice voices, ramped apart from the main playhead.
+    double voice_increment_step_ = 0;
+
     LutEnvelope env_;
     dsp::PulseGenerator eoc_pulse_;
     dsp::SchmittTrigger play_trigger, rec_trigger_;
     dsp::BooleanTrigger play_button_trigger_, rec_button_trigger_, loop_button_trigger_;
     dsp::Timer light_timer_;
 
-    // Sample rate conversion
-    dsp::SampleRateConverter<2> src_vcv_;
-    dsp::DoubleRingBuffer<dsp::Frame<2>, 256> output_buffer_;
-
+    // Oversampled rendering. Mono clips, one channel is enough.
+    static const int RENDER_BLOCK = 16;
+    static const int MAX_OVERSAMPLING = 4;
+    static const int SRC_LATENCY = 32;  // Half the 64 tap filter of the default SRC quality, at the output rate.
+    int oversampling_ = 1;
+    dsp::SampleRateConverter<1> src_vcv_;
+    dsp::DoubleRingBuffer<dsp::Frame<1>, 256> output_buffer_;
+
+    // TUNE input samples since the last rendered block, for audio rate FM.
+    float tune_buffer_[RENDER_BLOCK * 2];
+    int tune_count_ = 0;
+
+    // Scrub mode. START_INPUT is the read position, collected like the TUNE input.
+    float scrub_buffer_[RENDER_BLOCK * 2];
+    int scrub_count_ = 0;
+    double scrub_position_ = 0;
+    float scrub_coefficient_ = 1;
+
+    Looper looper_;
     AntipopFilter antipop_;
+    StateVariableFilter<float> filter_;
+    GrainEngine grains_;
+    TimeStretch stretch_;
+
+    // Slice voices. One per PLAY_INPUT channel.
+    static const int MAX_VOICES = 16;
+    SliceVoice voices_[MAX_VOICES];
+    StateVariableFilter<simd::float_4> voice_filters_[MAX_VOICES / 4];
+    dsp::SchmittTrigger voice_triggers_[MAX_VOICES];
+
+    // Clock sync. Times in engine samples since the clock was patched.
+    double sync_time_ = 0;
+    double sync_edge_ = -1;
+    double sync_period_ = 0;
+    int sync_beat_ = 0;
+    int sync_length_ = 0;  // Beats per loop, at control rate.
+    float clock_voltage_ = 0;
+
+    // Loop seam. Active when it matches the current loop points.
+    LoopSeam seam_;
+    bool seam_active_ = false;
+    float seam_phase_ = 0;
 
     AdvancedSampler() {
         config(NUM_PARAMS, NUM_INPUTS, NUM_OUTPUTS, NUM_LIGHTS);
@@ -86,22 +263,72 @@ struct AdvancedSampler : Module {
         configParam(PLAY_PARAM, 0.f, 1.f, 0.f, "Play");
         configParam(LOOP_PARAM, 0.f, 1.f, 0.f, "Loop");
         configParam(REC_PARAM,  0.f, 1.f, 0.f, "Record");
+        configParam(GRAIN_DENSITY_PARAM, 1.f, 100.f, 20.f, "Grain density", " grains/s");
+        configParam(GRAIN_SPRAY_PARAM,   0.f, 1.f, 0.f, "Grain spray", " %", 0.0f, 100);
+        configParam(STRETCH_PARAM, -2.f, 2.f, 0.f, "Stretch speed", "x", 2.0f);
+        configParam(FM_DEPTH_PARAM, 0.f, 4.f, 1.f, "Linear FM depth", " %", 0.0f, 100);
+        configParam(FILTER_CUTOFF_PARAM, 0.f, 1.f, 1.f, "Filter cutoff", " Hz", 1000.0f, 20.0f);
+        configParam(FILTER_RESONANCE_PARAM, 0.f, 1.f, 0.f, "Filter resonance", " %", 0.0f, 100);
+        configParam(FILTER_ENV_PARAM, -1.f, 1.f, 0.f, "Filter envelope amount", " octaves", 0.0f, 8);
+        configParam(SCRUB_SMOOTH_PARAM, 0.f, 1.f, 0.5f, "Scrub smoothing", " ms", 5000.0f, 0.1f);
+        configParam(LOOPER_FEEDBACK_PARAM, 0.f, 1.f, 1.f, "Overdub feedback", " %", 0.0f, 100);
+        configParam(ARM_THRESHOLD_PARAM, -60.f, 0.f, -30.f, "Arm threshold", " dB");
+        configParam(PRE_ROLL_PARAM, 0.f, MAX_PRE_ROLL_MS, 50.f, "Pre-roll", " ms");
+        setQuality(NORMAL_QUALITY);
         initializeClipCache();
+        analysis_worker_.start([this](int index) { analyzeClip(index); }, [this]() {
+            metadata_index_.flush();
+            prepareRecordSpare();
+            if (keymap_dirty_ || keymap_requested_.exchange(false)) {
+                keymap_dirty_ = false;
+                publishKeymap();
+            }
+        });
+        wavetable_worker_.start([this](int) { buildWavetable(); });
+    }
+
+    ~AdvancedSampler() {
+        analysis_worker_.stop();
+        wavetable_worker_.stop();
+        delete recording_clip_.load();
+        delete record_spare_.load();
     }
 
     json_t *dataToJson() override {
         json_t *rootJ = json_object();
         json_object_set_new(rootJ, "directory", json_string(directory_.c_str()));
+        json_object_set_new(rootJ, "quality", json_integer(quality_));
         json_object_set_new(rootJ, "loop", json_boolean(looping_));
         json_object_set_new(rootJ, "hold_envelope", json_boolean(hold_envelope_));
         json_object_set_new(rootJ, "playing", json_boolean(playing_));
         json_object_set_new(rootJ, "read_position", json_real(phase_));
         json_object_set_new(rootJ, "interpolation_mode", json_integer(interpolation_mode_));
-        json_object_set_new(rootJ, "slice", json_boolean(slice_));
+        json_object_set_new(rootJ, "slice_mode", json_integer(slice_mode_));
+        json_object_set_new(rootJ, "slice_trigger_mode", json_integer(slice_trigger_mode_));
+        json_object_set_new(rootJ, "normalise_mode", json_integer(normalise_mode_));
+        json_object_set_new(rootJ, "play_mode", json_integer(play_mode_));
+        json_object_set_new(rootJ, "wavetable_frames", json_integer(wavetable_frames_));
+        json_object_set_new(rootJ, "loop_mode", json_integer(loop_mode_));
+        json_object_set_new(rootJ, "snap_zero_crossings", json_boolean(snap_zero_crossings_));
+        json_object_set_new(rootJ, "keymap", json_boolean(keymap_));
+        json_object_set_new(rootJ, "clip_groups", json_boolean(clip_groups_));
+        json_object_set_new(rootJ, "morph", json_boolean(morph_));
+        json_object_set_new(rootJ, "looper", json_boolean(looper_mode_));
+        json_object_set_new(rootJ, "arm_recording", json_boolean(arm_recording_));
+        json_object_set_new(rootJ, "filter_mode", json_integer(filter_mode_));
+        json_object_set_new(rootJ, "sync_beats", json_integer(sync_beats_));
+        json_object_set_new(rootJ, "control_rate", json_integer(control_divider_.getDivision()));
+        json_object_set_new(rootJ, "tune_input_mode", json_integer(tune_input_mode_));
+        json_object_set_new(rootJ, "oversampling", json_integer(oversampling_));
         return rootJ;
     }
 
     void dataFromJson(json_t *rootJ) override {
+        // Tier first. Interpolation and control rate below override it.
+        json_t *qualityJ = json_object_get(rootJ, "quality");
+        if (qualityJ)
+            setQuality((QualityTiers)clamp((int)json_integer_value(qualityJ), 0, NUM_QUALITY_TIERS - 1));
+
         json_t *directoryJ = json_object_get(rootJ, "directory");
         if (directoryJ) {
             std::string directory = json_string_value(directoryJ);
@@ -128,24 +355,111 @@ struct AdvancedSampler : Module {
         if (playJ && directory_ != "")
             playing_ = json_boolean_value(playJ);
 
+        // Older patches only had equal slices.
         json_t *sliceJ = json_object_get(rootJ, "slice");
         if (sliceJ)
-            slice_ = json_boolean_value(sliceJ);
+            slice_mode_ = json_boolean_value(sliceJ) ? EQUAL_SLICES : NO_SLICES;
+
+        json_t *slice_modeJ = json_object_get(rootJ, "slice_mode");
+        if (slice_modeJ)
+            slice_mode_ = (SliceModes)clamp((int)json_integer_value(slice_modeJ), 0, NUM_SLICE_MODES - 1);
+
+        json_t *slice_triggerJ = json_object_get(rootJ, "slice_trigger_mode");
+        if (slice_triggerJ)
+            slice_trigger_mode_ = (SliceTriggerModes)clamp((int)json_integer_value(slice_triggerJ), 0, NUM_SLICE_TRIGGER_MODES - 1);
+
+        json_t *normaliseJ = json_object_get(rootJ, "normalise_mode");
+        if (normaliseJ)
+            normalise_mode_ = (NormaliseModes)clamp((int)json_integer_value(normaliseJ), 0, NUM_NORMALISE_MODES - 1);
+
+        json_t *play_modeJ = json_object_get(rootJ, "play_mode");
+        if (play_modeJ)
+            play_mode_ = (PlayModes)clamp((int)json_integer_value(play_modeJ), 0, NUM_PLAY_MODES - 1);
+
+        json_t *wavetable_framesJ = json_object_get(rootJ, "wavetable_frames");
+        if (wavetable_framesJ)
+            wavetable_frames_ = clamp((int)json_integer_value(wavetable_framesJ), 0, (int)Wavetable::MAX_FRAMES);
+
+        json_t *loop_modeJ = json_object_get(rootJ, "loop_mode");
+        if (loop_modeJ)
+            loop_mode_ = (LoopModes)clamp((int)json_integer_value(loop_modeJ), 0, NUM_LOOP_MODES - 1);
+
+        json_t *snapJ = json_object_get(rootJ, "snap_zero_crossings");
+        if (snapJ)
+            snap_zero_crossings_ = json_boolean_value(snapJ);
+
+        json_t *keymapJ = json_object_get(rootJ, "keymap");
+        if (keymapJ)
+            keymap_ = json_boolean_value(keymapJ);
+
+        json_t *clip_groupsJ = json_object_get(rootJ, "clip_groups");
+        if (clip_groupsJ)
+            clip_groups_ = json_boolean_value(clip_groupsJ);
+
+        json_t *morphJ = json_object_get(rootJ, "morph");
+        if (morphJ)
+            morph_ = json_boolean_value(morphJ);
+
+        json_t *looperJ = json_object_get(rootJ, "looper");
+        if (looperJ)
+            looper_mode_ = json_boolean_value(looperJ);
+        if (looper_mode_)
+            record_enabled_ = true;
+
+        json_t *arm_recordingJ = json_object_get(rootJ, "arm_recording");
+        if (arm_recordingJ)
+            arm_recording_ = json_boolean_value(arm_recordingJ);
+        if (arm_recording_)
+            record_enabled_ = true;
+
+        json_t *filter_modeJ = json_object_get(rootJ, "filter_mode");
+        if (filter_modeJ)
+            filter_mode_ = (FilterModes)clamp((int)json_integer_value(filter_modeJ), 0, NUM_FILTER_MODES - 1);
+
+        json_t *sync_beatsJ = json_object_get(rootJ, "sync_beats");
+        if (sync_beatsJ)
+            sync_beats_ = clamp((int)json_integer_value(sync_beatsJ), -1, 64);
+
+        json_t *control_rateJ = json_object_get(rootJ, "control_rate");
+        if (control_rateJ)
+            control_divider_.setDivision(clamp((int)json_integer_value(control_rateJ), 1, 256));
+
+        json_t *audio_rate_tuneJ = json_object_get(rootJ, "audio_rate_tune");
+        if (audio_rate_tuneJ && json_boolean_value(audio_rate_tuneJ))
+            tune_input_mode_ = AUDIO_RATE_TUNE_INPUT;
+
+        json_t *tune_input_modeJ = json_object_get(rootJ, "tune_input_mode");
+        if (tune_input_modeJ)
+            tune_input_mode_ = (TuneInputModes)clamp((int)json_integer_value(tune_input_modeJ), 0, NUM_TUNE_INPUT_MODES - 1);
+
+        json_t *oversamplingJ = json_object_get(rootJ, "oversampling");
+        if (oversamplingJ)
+            setOversampling(json_integer_value(oversamplingJ));
     }
 
     void onReset() override {
         playing_ = false;
     }
 
+    void onSampleRateChange(const SampleRateChangeEvent &e) override {
+        looper_.allocate(e.sampleRate);
+        pre_roll_.allocate(MAX_PRE_ROLL_MS * 0.001f * e.sampleRate);
+    }
+
     void process(const ProcessArgs &args) override {
+        // Clips fetched during this sample stay alive until it ends.
+        ClipSlots<MAX_FILES>::ReadGuard clip_guard(clips_, ClipSlots<MAX_FILES>::AUDIO_READER);
+
+        if (control_divider_.process())
+            updateControlRate(args);
 
         // Update lights
-        light_timer_.process(args.sampleTime);
-        if (light_timer_.process(args.sampleTime) > UI_update_time) {
+        if (light_timer_.process(args.sampleTime) > ui_update_time_) {
             light_timer_.reset();
-            lights[LOOP_LIGHT].setSmoothBrightness(looping_  ? .5f : 0.0f, UI_update_time);
-            lights[PLAY_LIGHT].setSmoothBrightness(playing_  ? .5f : 0.0f, UI_update_time);
-            lights[REC_LIGHT_RED].setSmoothBrightness(recording_ ? .5f : 0.0f, UI_update_time);
+            lights[LOOP_LIGHT].setSmoothBrightness(looping_  ? .5f : 0.0f, ui_update_time_);
+            lights[PLAY_LIGHT].setSmoothBrightness(playing_  ? .5f : 0.0f, ui_update_time_);
+            const bool looper_recording = looper_mode_ && (looper_.getState() == Looper::RECORDING || looper_.getState() == Looper::OVERDUBBING);
+            lights[REC_LIGHT_RED].setSmoothBrightness(recording_ || looper_recording ? .5f : armed_ || record_pending_ ? .15f : 0.0f, ui_update_time_);
         }
 
         // Rec button & CV
@@ -157,9 +471,31 @@ struct AdvancedSampler : Module {
             if (rec_trigger_.process(inputs[REC_INPUT].getVoltage()))
                 switchRec(args.sampleRate);
 
+        if (record_pending_ && startRecord(args.sampleRate))
+            record_pending_ = false;
+
+        // Armed. Keep the pre-roll and start once channel 0 crosses the threshold.
+        if (armed_) {
+            pre_roll_.push(inputs[AUDIO_INPUT].getVoltages());
+            if (std::abs(inputs[AUDIO_INPUT].getVoltage() / 5.0f) > arm_threshold_ && startRecord(args.sampleRate)) {
+                AudioClip &clip = *recording_clip_;
+                pre_roll_.drain(pre_roll_samples_ + 1, [&](const float *frame) {
+                    if (recording_)
+                        recording_ = clip.rec(frame, 0.2f);
+                });
+                if (!recording_)
+                    stopRecord();
+
+                outputs[AUDIO_OUTPUT].setVoltage(0);
+                outputs[EOC_OUTPUT].setVoltage(0);
+                return;
+            }
+        }
+
         // Recording process.
         if (recording_) {
-            recording_ = clip_cache_[getClipIndex()].rec(inputs[AUDIO_INPUT].getVoltage() / 5.0f);
+            // Every channel of the cable, poly or stereo.
+            recording_ = recording_clip_.load()->rec(inputs[AUDIO_INPUT].getVoltages(), 0.2f);
 
             // Handle max record time.
             if (!recording_)
@@ -171,63 +507,206 @@ struct AdvancedSampler : Module {
         }
 
         // Play button & cv.
-        if (clip_cache_[getClipIndex()].isLoaded()) {
+        if (getClip(clip_index_).isLoaded()) {
             if (play_button_trigger_.process(params[PLAY_PARAM].getValue()))
-                trigger();
-
-            if (inputs[PLAY_INPUT].isConnected())
+                trigger(args);
+
+            // PLAY_INPUT triggers slices instead.
+            if (slice_trigger_mode_ != NO_SLICE_TRIGGER)
+                triggerSlices();
+            else if (inputs[PLAY_INPUT].isConnected() && sync_beats_ != 0)
+                processClock(args);
+            else if (inputs[PLAY_INPUT].isConnected())
                 if (play_trigger.process(inputs[PLAY_INPUT].getVoltage()))
-                    trigger();
+                    trigger(args);
         }
 
         // Loop button & cv.
         if (loop_button_trigger_.process(params[LOOP_PARAM].getValue()))
             looping_ = !looping_;
 
-        if (!playing_) {
-            outputs[AUDIO_OUTPUT].setVoltage(0);
-            outputs[EOC_OUTPUT].setVoltage(eoc_pulse_.process(args.sampleTime) ? 10.0f : 0.0f);
+        float out = 0;
+
+        // Blocks are rendered ahead, keep the audio rate input for the next one.
+        const bool block_pass = oversampling_ > 1 && (playing_ || !output_buffer_.empty());
+        if (block_pass && tune_input_mode_ != VOCT_TUNE_INPUT && tune_count_ < RENDER_BLOCK * 2)
+            tune_buffer_[tune_count_++] = inputs[TUNE_INPUT].getVoltage();
+        if (block_pass && play_mode_ == SCRUB_MODE && scrub_count_ < RENDER_BLOCK * 2)
+            scrub_buffer_[scrub_count_++] = inputs[START_INPUT].getVoltage();
+
+        // Oversampled path. Keeps draining the buffer after playback stops.
+        if (block_pass)
+            out = BlockPass(args);
+        else if (playing_)
+            out = SinglePass(args);
+
+        if (filter_mode_ != NO_FILTER)
+            out = filter_.process(out, filter_mode_);
+
+        if (slice_trigger_mode_ != NO_SLICE_TRIGGER)
+            out += renderVoices(args);
+
+        // The looper runs at engine rate, punches land on the trigger sample.
+        float loop = 0;
+        if (looper_mode_)
+            loop = looper_.process(inputs[AUDIO_INPUT].getVoltage() / 5.0f);
+
+        if (normalise_mode_ != NO_NORMALISE)
+            clip_gain_ += clip_gain_step_;
+
+        // Set module outputs.
+        outputs[AUDIO_OUTPUT].setVoltage((out * clip_gain_ + loop) * 5);
+        outputs[EOC_OUTPUT].setVoltage(eoc_pulse_.process(args.sampleTime) ? 10.0f : 0.0f);
+    }
+
+    // Gate mode: channel N plays slice N. CV mode: START_INPUT channel N picks the slice, 0V to 10V.
+    void triggerSlices() {
+        const int channels = std::min(inputs[PLAY_INPUT].getChannels(), (int)MAX_VOICES);
+        const int slice_count = getSliceCount();
+
+        for (int c = 0; c < channels; c++) {
+            if (!voice_triggers_[c].process(inputs[PLAY_INPUT].getVoltage(c)))
+                continue;
+
+            int slice = c;
+            if (slice_trigger_mode_ == CV_SLICE_TRIGGER)
+                slice = inputs[START_INPUT].getPolyVoltage(c) / 10.0f * slice_count;
+
+            uint32_t start, end;
+            getSlice(clamp(slice, 0, slice_count - 1), start, end);
+            voices_[c].trigger(start, end);
+        }
+    }
+
+    inline float renderVoices(const ProcessArgs &args) {
+        AudioClip &clip = getClip(clip_index_);
+
+        // Stops at the target when a trigger stretches the control period.
+        voice_increment_ += voice_increment_step_;
+        if ((voice_increment_step_ > 0) == (voice_increment_ > increment_target_))
+            voice_increment_ = increment_target_;
+        const double increment = voice_increment_ * clip.getSampleCount();
+
+        alignas(16) float outs[MAX_VOICES];
+        for (int v = 0; v < MAX_VOICES; v++)
+            outs[v] = voices_[v].process(clip, interpolation_mode_, increment, args.sampleTime);
+
+        // Four voices per filter.
+        simd::float_4 sum = 0;
+        for (int v = 0; v < MAX_VOICES; v += 4) {
+            simd::float_4 x = simd::float_4::load(&outs[v]);
+            sum += filter_mode_ != NO_FILTER ? voice_filters_[v / 4].process(x, filter_mode_) : x;
+        }
+        return sum[0] + sum[1] + sum[2] + sum[3];
+    }
+
+    // Transient slices when available, equal divisions otherwise.
+    int getSliceCount() {
+        SliceTable &slices = getClip(clip_index_).getSlices();
+        if (slice_mode_ == TRANSIENT_SLICES && slices.count_ > 0)
+            return slices.count_;
+        return slice_division_;
+    }
+
+    // Slice bounds in clip samples. O(1).
+    void getSlice(int index, uint32_t &start, uint32_t &end) {
+        AudioClip &clip = getClip(clip_index_);
+        SliceTable &slices = clip.getSlices();
+        if (slice_mode_ == TRANSIENT_SLICES && slices.count_ > 0) {
+            start = slices.slices_[index].start;
+            end = slices.slices_[index].end;
             return;
         }
 
-        SinglePass(args);
+        const uint32_t count = clip.getSampleCount();
+        start = (uint64_t)count * index / slice_division_;
+        end = (uint64_t)count * (index + 1) / slice_division_;
     }
     
-    inline void SinglePass(const ProcessArgs &args) {
+    // Values that do not need to change every sample. Clip index, phase
+    // bounds, pitch increment and envelope increments.
+    void updateControlRate(const ProcessArgs &args) {
+        // Renders read the latched table until the next tick.
+        wavetable_read_index_ = wavetable_index_.load(std::memory_order_acquire);
+        wavetable_reading_.store(wavetable_read_index_, std::memory_order_release);
+
+        clip_index_ = getClipIndex();
+        AudioClip &clip = getClip(clip_index_);
+
+        start_phase_ = getPhaseStart();
+        end_phase_ = getPhaseEnd();
+        clip_gain_step_ = (calculateClipGain(clip) - clip_gain_) / control_divider_.getDivision();
+        if (normalise_mode_ == NO_NORMALISE)
+            clip_gain_ = 1.0f;
+
+        // The fractional SAMPLE position crossfades into the next clip.
+        morph_active_ = morph_ && !isKeymapped() && play_mode_ == SAMPLER_MODE && clip.getSampleCount() >= 4;
+        if (morph_active_) {
+            const float position = getParamModulated(SAMPLE_PARAM, 0.1f) * std::max(clip_count_ - 1, 0);
+            morph_clip_ = std::min(clip_index_ + 1, std::max(clip_count_ - 1, 0));
+            morph_mix_ = clamp(position - clip_index_, 0.0f, 1.0f);
+            if (getClip(morph_clip_).getSampleCount() < 4)
+                morph_mix_ = 0;
+        }
 
-        int clip_index = getClipIndex();
-        int clip_samplerate = clip_cache_[clip_index].getSampleRate();
+        // Increment at 0V. Cheap SR conversion for clips, C4 cycles for wavetables.
+        increment_scale_ = clip.getSampleTime();
+        if (clip.isLoaded() && args.sampleRate != clip.getSampleRate())
+            increment_scale_ *= clip.getSampleRate() * args.sampleTime;
+        if (play_mode_ == WAVETABLE_MODE)
+            increment_scale_ = dsp::FREQ_C4 * args.sampleTime;
+
+        // Keymapped clips play relative to their root note.
+        tune_offset_ = isKeymapped() ? (60 - keymap_root_) / 12.0f : 0.0f;
+
+        // Ramp to the new increment during the next control period.
+        // With linear FM the input only modulates around the knob pitch.
+        const float tune_input = tune_input_mode_ == LINEAR_FM_TUNE_INPUT ? 0.0f : inputs[TUNE_INPUT].getVoltage();
+        const float tune = clamp(params[TUNE_PARAM].getValue() + tune_input + tune_offset_, -4.0f, 4.0f);
+        double target = calculateIncrement(tune);
+        sync_length_ = getSyncLength(clip);
+        if (isSynced())
+            target = fabsf(end_phase_ - start_phase_) / (sync_length_ * sync_period_);
+        increment_target_ = target;
+        increment_step_ = (target - increment_) / control_divider_.getDivision();
+        voice_increment_step_ = (target - voice_increment_) / control_divider_.getDivision();
+
+        // START is grain position, END grain size from 10ms to 1s.
+        if (play_mode_ == GRANULAR_MODE) {
+            grains_.position_ = start_phase_;
+            grains_.size_ = 0.01f * powf(100.0f, getParamModulated(END_PARAM, 0.1f));
+            grains_.density_ = params[GRAIN_DENSITY_PARAM].getValue();
+            grains_.spray_ = params[GRAIN_SPRAY_PARAM].getValue();
+            grains_.pitch_ = dsp::approxExp2_taylor5(tune + 20) / 1048576;
+        }
 
-        // Calculate pitch.
-        float octave = getParamModulated(TUNE_PARAM, 1.0f, -4.0f, 4.0f);
-        
-        // Cheap SR conversion.
-        if (args.sampleRate != clip_samplerate)
-            octave += log2f(clip_samplerate * args.sampleTime);
-        
-        // Calculate increment
-        float freq = dsp::approxExp2_taylor5((octave) + 20) / 1048576 * clip_cache_[clip_index].getSampleTime();
+        // START scans the frames. Rebuild when the clip or the layout changes.
+        if (play_mode_ == WAVETABLE_MODE) {
+            wavetable_position_ = getParamModulated(START_PARAM, 0.1f);
+            const int key = getWavetableKey();
+            if (wavetable_key_.exchange(key) != key)
+                wavetable_worker_.request(0);
+        }
 
-        // Move read position.
-        float start_phase = getPhaseStart();
-        float end_phase = getPhaseEnd();
-        bool forward = end_phase >= start_phase;
-        phase_ += forward ? freq : -freq;
+        looper_.feedback_ = params[LOOPER_FEEDBACK_PARAM].getValue();
+        arm_threshold_ = powf(10.0f, params[ARM_THRESHOLD_PARAM].getValue() / 20.0f);
+        pre_roll_samples_ = params[PRE_ROLL_PARAM].getValue() * 0.001f * args.sampleRate;
 
-        // Warp at start & end or stop.
-        float min_phase = std::min(start_phase, end_phase);
-        float max_phase = std::max(start_phase, end_phase);
-        bool last_sample = (forward && phase_ >= max_phase) || (!forward && phase_ < min_phase);
-        if (last_sample && playing_) {
-            playing_ = looping_;
-            phase_ = start_phase;
-            eoc_pulse_.trigger();
+        // One pole towards the scrub target, 0.1ms to 500ms at the render rate.
+        if (play_mode_ == SCRUB_MODE) {
+            const float time = 0.0001f * powf(5000.0f, params[SCRUB_SMOOTH_PARAM].getValue());
+            const float render_time = oversampling_ > 1 ? args.sampleTime / oversampling_ : args.sampleTime;
+            scrub_coefficient_ = 1.0f - expf(-render_time / time);
         }
 
-        // dont get audio when stoped this frame.
-        float clip_sample = playing_
-                            ? clip_cache_[clip_index].getSamplePhase(phase_, interpolation_mode_)
-                            : 0;
+        // TUNE is pitch only, speed comes from STRETCH_PARAM.
+        if (play_mode_ == STRETCH_MODE) {
+            const float speed = dsp::approxExp2_taylor5(params[STRETCH_PARAM].getValue() + 20) / 1048576;
+            stretch_.speed_ = end_phase_ >= start_phase_ ? speed : -speed;
+            stretch_.pitch_ = dsp::approxExp2_taylor5(tune + 20) / 1048576;
+        }
+
+        updateLoopSeam(args);
 
         // Update amp envelope.
         const float attack = getParamModulated(ATTACK_PARAM, 0.1f);
@@ -237,53 +716,515 @@ struct AdvancedSampler : Module {
             env_.envelopeHD(attack, decay); // Hold & Decay
         else
             env_.envelopeAD(attack, decay); // Attack & Decay
-        
-        float env_level = env_.process(args.sampleTime);
-        float filter_out = antipop_.process(clip_sample * env_level, args);
 
-        // Set module outputs.
-        outputs[AUDIO_OUTPUT].setVoltage(filter_out * 5);
-        outputs[EOC_OUTPUT].setVoltage(eoc_pulse_.process(args.sampleTime) ? 10 : 0);
+        if (slice_trigger_mode_ != NO_SLICE_TRIGGER) {
+            for (int v = 0; v < MAX_VOICES; v++) {
+                if (hold_envelope_)
+                    voices_[v].env_.envelopeHD(attack, decay);
+                else
+                    voices_[v].env_.envelopeAD(attack, decay);
+            }
+        }
+
+        if (filter_mode_ != NO_FILTER)
+            updateFilters(args);
+    }
+
+    // Cutoff follows each voice's amp envelope by FILTER_ENV_PARAM octaves. Q from 0.5 to 20.
+    void updateFilters(const ProcessArgs &args) {
+        const float cutoff = 20.0f * powf(1000.0f, params[FILTER_CUTOFF_PARAM].getValue());
+        const float env_octaves = 8.0f * params[FILTER_ENV_PARAM].getValue();
+        const float damping = 2.0f * powf(40.0f, -params[FILTER_RESONANCE_PARAM].getValue());
+        const float max_cutoff = 0.45f * args.sampleRate;
+
+        filter_.setCoefficients(std::min(cutoff * exp2f(env_octaves * env_.getValue()), max_cutoff), damping, args.sampleTime);
+
+        if (slice_trigger_mode_ == NO_SLICE_TRIGGER)
+            return;
+
+        alignas(16) float env_levels[MAX_VOICES];
+        for (int v = 0; v < MAX_VOICES; v++)
+            env_levels[v] = voices_[v].env_.getValue();
+
+        for (int v = 0; v < MAX_VOICES; v += 4) {
+            simd::float_4 voice_cutoff = cutoff * dsp::exp2_taylor5(env_octaves * simd::float_4::load(&env_levels[v]));
+            voice_filters_[v / 4].setCoefficients(simd::fmin(voice_cutoff, max_cutoff), damping, args.sampleTime);
+        }
+    }
+
+    // Peak normalise to 0dBFS or loudness normalise to -16 LUFS without
+    // clipping. Near silent clips stop at MAX_CLIP_GAIN.
+    float calculateClipGain(AudioClip &clip) {
+        const float peak = clip.getPeak();
+        if (normalise_mode_ == NO_NORMALISE || peak <= 0.0f)
+            return 1.0f;
+
+        const float peak_gain = std::min(1.0f / peak, MAX_CLIP_GAIN);
+        if (normalise_mode_ == PEAK_NORMALISE)
+            return peak_gain;
+
+        const float target_lufs = -16.0f;
+        return std::min(powf(10.0f, (target_lufs - clip.getLufs()) / 20.0f), peak_gain);
+    }
+
+    // Crossfaded seam of 10ms, built once the loop points hold still for 10ms.
+    void updateLoopSeam(const ProcessArgs &args) {
+        AudioClip &clip = getClip(clip_index_);
+        seam_active_ = false;
+
+        if (!looping_ || play_mode_ != SAMPLER_MODE || loop_mode_ == PINGPONG_LOOP || morph_active_ || !clip.isLoaded())
+            return;
+
+        const int count = clip.getSampleCount();
+        const int start = std::min(start_phase_, end_phase_) * count;
+        const int end = std::max(start_phase_, end_phase_) * count;
+        const int length = clip.getSampleRate() * 0.01f;
+        const int settle_updates = std::max(2, (int)(0.01f * args.sampleRate / control_divider_.getDivision()));
+
+        seam_active_ = seam_.update(clip.data(), count, clip.getGeneration(), start, end, length, settle_updates);
+        seam_phase_ = (float)seam_.getLength() / count;
+    }
+
+    inline bool isForward() {
+        bool forward = end_phase_ >= start_phase_;
+        if (loop_mode_ == REVERSE_LOOP)
+            forward = !forward;
+        if (loop_mode_ == PINGPONG_LOOP && ping_pong_reversed_)
+            forward = !forward;
+        return forward;
+    }
+
+    // Where playback starts and loops back to.
+    inline float getLoopStart() {
+        return loop_mode_ == REVERSE_LOOP ? end_phase_ : start_phase_;
+    }
+
+    void setQuality(QualityTiers quality) {
+        const QualityTier &tier = quality_tiers_[quality];
+        quality_ = quality;
+        interpolation_mode_ = tier.interpolation;
+        control_divider_.setDivision(tier.control_rate);
+        use_mipmaps_ = tier.mipmaps;
+        ui_update_time_ = 1.f / tier.display_rate;
+    }
+
+    void setOversampling(int oversampling) {
+        oversampling_ = clamp(oversampling, 1, (int)MAX_OVERSAMPLING);
+        output_buffer_.clear();
+    }
+
+    inline double calculateIncrement(float octave) {
+        return dsp::approxExp2_taylor5(octave + 20) / 1048576 * increment_scale_;
+    }
+
+    // Next read increment. ratio scales the per engine sample increment.
+    // Linear FM can go through zero, a negative increment plays backwards.
+    inline double nextIncrement(float ratio, float tune_voltage) {
+        if (tune_input_mode_ == AUDIO_RATE_TUNE_INPUT && !isSynced())
+            return calculateIncrement(clamp(params[TUNE_PARAM].getValue() + tune_voltage + tune_offset_, -4.0f, 4.0f)) * ratio;
+
+        increment_ += increment_step_ * ratio;
+        if (tune_input_mode_ == LINEAR_FM_TUNE_INPUT)
+            return increment_ * ratio * (1.0f + params[FM_DEPTH_PARAM].getValue() * tune_voltage * 0.2f);
+
+        return increment_ * ratio;
+    }
+
+    // Stretch the input samples collected since the last block over length frames.
+    static void stretchInputBuffer(const float *buffer, int count, float *out, int length) {
+        for (int i = 0; i < length; i++) {
+            const float x = (float)i * count / length;
+            const int xi = (int)x;
+            out[i] = crossfade(buffer[xi], buffer[std::min(xi + 1, count - 1)], x - xi);
+        }
+    }
+
+    // Increments for a whole oversampled block. The TUNE input collected since the
+    // last block is stretched over it and converted four frames at a time.
+    void calculateBlockIncrements(float *increments, int length, float ratio) {
+        if (tune_input_mode_ == VOCT_TUNE_INPUT || tune_count_ == 0 || isSynced()) {
+            for (int i = 0; i < length; i++)
+                increments[i] = nextIncrement(ratio, 0.0f);
+            tune_count_ = 0;
+            return;
+        }
+
+        alignas(16) float voltages[RENDER_BLOCK * MAX_OVERSAMPLING];
+        stretchInputBuffer(tune_buffer_, tune_count_, voltages, length);
+        tune_count_ = 0;
+
+        if (tune_input_mode_ == AUDIO_RATE_TUNE_INPUT) {
+            const float octave = params[TUNE_PARAM].getValue() + tune_offset_;
+            const float scale = increment_scale_ * ratio / 1048576;
+            for (int i = 0; i < length; i += 4) {
+                simd::float_4 x = simd::clamp(octave + simd::float_4::load(&voltages[i]), -4.0f, 4.0f);
+                simd::float_4 increment = dsp::exp2_taylor5(x + 20) * scale;
+                increment.store(&increments[i]);
+            }
+            return;
+        }
+
+        // Linear FM, the base increment keeps ramping towards the control rate target.
+        const float depth = params[FM_DEPTH_PARAM].getValue() * 0.2f;
+        alignas(16) float base[RENDER_BLOCK * MAX_OVERSAMPLING];
+        for (int i = 0; i < length; i++) {
+            increment_ += increment_step_ * ratio;
+            base[i] = increment_ * ratio;
+        }
+        for (int i = 0; i < length; i += 4) {
+            simd::float_4 increment = simd::float_4::load(&base[i]) * (1.0f + depth * simd::float_4::load(&voltages[i]));
+            increment.store(&increments[i]);
+        }
+    }
+
+    // START_INPUT at 10V spans the whole clip.
+    inline float getScrubTarget(float voltage) {
+        return clamp(params[START_PARAM].getValue() + voltage * 0.1f, 0.0f, 1.0f);
+    }
+
+    // Scrub targets for a whole oversampled block.
+    void calculateBlockScrub(float *targets, int length) {
+        if (scrub_count_ == 0) {
+            std::fill(targets, targets + length, getScrubTarget(inputs[START_INPUT].getVoltage()));
+            return;
+        }
+
+        stretchInputBuffer(scrub_buffer_, scrub_count_, targets, length);
+        for (int i = 0; i < length; i++)
+            targets[i] = getScrubTarget(targets[i]);
+        scrub_count_ = 0;
+    }
+
+    inline float SinglePass(const ProcessArgs &args) {
+        if (play_mode_ == SCRUB_MODE)
+            return renderScrub(args.sampleTime, getScrubTarget(inputs[START_INPUT].getVoltage()));
+
+        return renderSample(args.sampleTime, nextIncrement(1.0f, inputs[TUNE_INPUT].getVoltage()));
+    }
+
+    // Render RENDER_BLOCK frames at oversampling_ times the engine rate and
+    // decimate them into output_buffer_.
+    void renderBlock(const ProcessArgs &args) {
+        dsp::Frame<1> in[RENDER_BLOCK * MAX_OVERSAMPLING];
+        const float sample_time = args.sampleTime / oversampling_;
+        const float ratio = 1.0f / oversampling_;
+
+        int in_len = RENDER_BLOCK * oversampling_;
+        alignas(16) float increments[RENDER_BLOCK * MAX_OVERSAMPLING];
+
+        // Blocks are rendered ahead of the control ticks. Ramp to the latest
+        // target over the block's RENDER_BLOCK engine samples.
+        increment_step_ = (increment_target_ - increment_) / RENDER_BLOCK;
+
+        if (play_mode_ == SCRUB_MODE) {
+            calculateBlockScrub(increments, in_len);
+            tune_count_ = 0;
+            for (int i = 0; i < in_len; i++)
+                in[i].samples[0] = renderScrub(sample_time, increments[i]);
+        }
+        else {
+            calculateBlockIncrements(increments, in_len, ratio);
+            for (int i = 0; i < in_len; i++)
+                in[i].samples[0] = renderSample(sample_time, increments[i]);
+        }
+
+        src_vcv_.setRates(args.sampleRate * oversampling_, args.sampleRate);
+        int out_len = output_buffer_.capacity();
+        src_vcv_.process(in, &in_len, output_buffer_.endData(), &out_len);
+        output_buffer_.endIncr(out_len);
+    }
+
+    inline float BlockPass(const ProcessArgs &args) {
+        if (output_buffer_.empty())
+            renderBlock(args);
+
+        return output_buffer_.empty() ? 0 : output_buffer_.shift().samples[0];
+    }
+
+    // Grain cloud * envelope. Plays until the envelope ends, or forever while looping.
+    inline float renderGrains(float sample_time) {
+        float clip_sample = grains_.process(getClip(clip_index_), interpolation_mode_, sample_time);
+        float env_level = env_.process(sample_time);
+
+        if (playing_ && !looping_ && env_.isDone()) {
+            playing_ = false;
+            eoc_pulse_.trigger();
+        }
+
+        phase_ = grains_.position_;
+        return antipop_.process(clip_sample * env_level, sample_time);
+    }
+
+    // Wavetable oscillator * envelope. Plays until the envelope ends, or forever while looping.
+    inline float renderWavetable(float sample_time, double freq) {
+        Wavetable &wavetable = wavetables_[wavetable_read_index_];
+        float clip_sample = wavetable.process(wavetable_phase_, wavetable_position_, freq);
+
+        // Through zero FM can run the cycle backwards.
+        wavetable_phase_ += freq;
+        wavetable_phase_ -= floorf(wavetable_phase_);
+
+        float env_level = env_.process(sample_time);
+        if (playing_ && !looping_ && env_.isDone()) {
+            playing_ = false;
+            eoc_pulse_.trigger();
+        }
+
+        phase_ = wavetable_position_;
+        return antipop_.process(clip_sample * env_level, sample_time);
+    }
+
+    // Clip read at the smoothed scrub position * envelope. Plays until the envelope
+    // ends, or forever while looping. Out of range targets clamp to the clip ends.
+    inline float renderScrub(float sample_time, float target) {
+        scrub_position_ += (target - scrub_position_) * scrub_coefficient_;
+
+        float clip_sample = 0;
+        if (playing_)
+            clip_sample = getClip(clip_index_).getSamplePhase(scrub_position_, interpolation_mode_);
+
+        float env_level = env_.process(sample_time);
+        if (playing_ && !looping_ && env_.isDone()) {
+            playing_ = false;
+            eoc_pulse_.trigger();
+        }
+
+        phase_ = scrub_position_;
+        return antipop_.process(clip_sample * env_level, sample_time);
+    }
+
+    // Time stretched clip * envelope.
+    inline float renderStretch(float sample_time) {
+        AudioClip &clip = getClip(clip_index_);
+        const double count = clip.getSampleCount();
+
+        float clip_sample = 0;
+        if (playing_ && count >= TimeStretch::FRAME_SIZE) {
+            const double min_index = std::min(start_phase_, end_phase_) * count;
+            const double max_index = std::max(start_phase_, end_phase_) * count;
+            if (!stretch_.process(clip, interpolation_mode_, sample_time, min_index, max_index, looping_, &clip_sample)) {
+                playing_ = false;
+                eoc_pulse_.trigger();
+            }
+            phase_ = stretch_.getIndex() / count;
+        }
+
+        float env_level = env_.process(sample_time);
+        return antipop_.process(clip_sample * env_level, sample_time);
+    }
+
+    // One sample of clip * envelope, moving the read position by freq.
+    inline float renderSample(float sample_time, double freq) {
+        if (play_mode_ == GRANULAR_MODE)
+            return renderGrains(sample_time);
+
+        if (play_mode_ == STRETCH_MODE)
+            return renderStretch(sample_time);
+
+        if (play_mode_ == WAVETABLE_MODE)
+            return renderWavetable(sample_time, freq);
+
+        int clip_index = clip_index_;
+
+        // Move read position.
+        const bool forward = isForward();
+        phase_ += forward ? freq : -freq;
+
+        // Warp, bounce or stop at start & end.
+        const float min_phase = std::min(start_phase_, end_phase_);
+        const float max_phase = std::max(start_phase_, end_phase_);
+        bool last_sample = (forward && phase_ >= max_phase) || (!forward && phase_ < min_phase);
+        if (last_sample && playing_) {
+            playing_ = looping_;
+            eoc_pulse_.trigger();
+
+            if (!looping_) {
+                phase_ = getLoopStart();
+            }
+            else if (loop_mode_ == PINGPONG_LOOP) {
+                phase_ = forward ? 2 * max_phase - phase_ : 2 * min_phase - phase_;
+                ping_pong_reversed_ ^= true;
+            }
+            else if (seam_active_) {
+                // The seam already faded into the loop start.
+                phase_ = forward ? min_phase + seam_phase_ + (phase_ - max_phase) : max_phase - seam_phase_ - (min_phase - phase_);
+            }
+            else {
+                phase_ = forward ? min_phase : max_phase;
+                antipop_.trigger();
+            }
+        }
+
+        // Through zero FM runs against the play direction. Wrap while looping,
+        // otherwise hold at the loop start until the FM turns around.
+        if (phase_ < min_phase)
+            phase_ = looping_ ? phase_ + (max_phase - min_phase) : min_phase;
+        else if (phase_ > max_phase)
+            phase_ = looping_ ? phase_ - (max_phase - min_phase) : max_phase;
+
+        // dont get audio when stoped this frame.
+        float clip_sample = 0;
+        if (playing_) {
+            AudioClip &clip = getClip(clip_index);
+            if (seam_active_ && forward && phase_ >= max_phase - seam_phase_)
+                clip_sample = seam_.read((phase_ - (max_phase - seam_phase_)) * clip.getSampleCount(), interpolation_mode_);
+            else if (seam_active_ && !forward && phase_ < min_phase + seam_phase_)
+                clip_sample = seam_.read((phase_ - min_phase) * clip.getSampleCount(), interpolation_mode_);
+            else if (morph_active_)
+                clip_sample = AudioClip::getMorphSample(clip, getClip(morph_clip_), phase_, morph_mix_);
+            else
+                clip_sample = clip.getSamplePhase(phase_, interpolation_mode_);
+        }
+
+        float env_level = env_.process(sample_time);
+        return antipop_.process(clip_sample * env_level, sample_time);
     }
 
-    inline void trigger() {
+    // Extra output delay of the oversampled path, in engine samples. The
+    // block rendered ahead plus the decimation filter.
+    int getLatency() {
+        return oversampling_ > 1 ? RENDER_BLOCK + SRC_LATENCY : 0;
+    }
+
+    inline void trigger(const ProcessArgs &args) {
+        // The note at trigger time picks the clip. 0V is C4.
+        KeyMap &keymap = getKeymap();
+        if (keymap_ && keymap.isMapped()) {
+            const int note = clamp((int)roundf(60 + 12 * inputs[TUNE_INPUT].getVoltage()), 0, KeyMap::NUM_NOTES - 1);
+            keymap_clip_ = keymap.getClip(note);
+            keymap_root_ = keymap.getRoot(note);
+        }
+
+        // Velocity layer and round robin member. AUDIO_INPUT is velocity, 0V to 10V.
+        group_clip_ = -1;
+        if (clip_groups_) {
+            const float velocity = inputs[AUDIO_INPUT].isConnected() ? clamp(inputs[AUDIO_INPUT].getVoltage() * 0.1f, 0.0f, 1.0f) : 1.0f;
+            group_clip_ = getGroups().select(getBaseClipIndex(), velocity);
+        }
+
+        // Start with fresh control values and no pitch ramp.
+        updateControlRate(args);
+        control_divider_.reset();
+        increment_ += increment_step_ * control_divider_.getDivision();
+        increment_step_ = 0;
+
         playing_ = true;
         env_.tigger(true);
-        phase_ = getPhaseStart();
+        ping_pong_reversed_ = false;
+        phase_ = getLoopStart();
+        grains_.reset();
+        wavetable_phase_ = 0;
+        scrub_position_ = getScrubTarget(inputs[START_INPUT].getVoltage());
+        stretch_.reset(start_phase_ * getClip(clip_index_).getSampleCount());
         
         if (playing_)
             antipop_.trigger();
     }
 
-    void startRecord(int sampleRate) {
+    // Sampler loops only. Needs one full clock period first.
+    inline bool isSynced() {
+        return sync_length_ > 0 && sync_period_ > 0 && play_mode_ == SAMPLER_MODE && slice_trigger_mode_ == NO_SLICE_TRIGGER;
+    }
+
+    // Beats per loop. Auto fits the detected tempo to the loop region.
+    int getSyncLength(AudioClip &clip) {
+        if (sync_beats_ >= 0)
+            return sync_beats_;
+
+        const float bpm = clip.getBpm();
+        if (bpm <= 0)
+            return 4;
+        return std::max(1, (int)roundf(fabsf(end_phase_ - start_phase_) * clip.getSeconds() * bpm / 60.0f));
+    }
+
+    // PLAY_INPUT as a clock. The period is measured between sub-sample edge
+    // times, and every sync_length_ clocks the read position snaps to the loop
+    // start, plus the part of a sample that already went by since the edge.
+    void processClock(const ProcessArgs &args) {
+        const float voltage = inputs[PLAY_INPUT].getVoltage();
+        sync_time_ += 1.0;
+
+        if (play_trigger.process(voltage)) {
+            // Linear estimate of when the input crossed the 1V threshold.
+            const float rise = voltage - clock_voltage_;
+            const double ago = rise > 0 ? clamp((voltage - 1.0f) / rise, 0.0f, 1.0f) : 0.0f;
+            const double edge = sync_time_ - ago;
+            if (sync_edge_ >= 0 && edge > sync_edge_)
+                sync_period_ = edge - sync_edge_;
+            sync_edge_ = edge;
+
+            const int length = std::max(sync_length_, 1);
+            if (sync_beat_ % length == 0) {
+                const double previous_phase = phase_;
+                if (!playing_)
+                    trigger(args);
+
+                const double start = getLoopStart() + (isForward() ? ago : -ago) * increment_;
+                if (playing_ && fabs(previous_phase - start) > 2 * increment_)
+                    antipop_.trigger();
+                phase_ = start;
+            }
+            sync_beat_ = (sync_beat_ + 1) % length;
+        }
+
+        clock_voltage_ = voltage;
+    }
+
+    // Records into the preallocated spare, published when the recording stops.
+    // False while the worker has not replaced the last one yet.
+    bool startRecord(int sampleRate) {
+        AudioClip *clip = record_spare_.exchange(nullptr);
+        if (!clip)
+            return false;
+
         recording_ = true;
+        armed_ = false;
         playing_ = false;
+        keymap_clip_ = -1;
+        group_clip_ = -1;
         clip_count_ = clamp(clip_count_ + 1, 0, MAX_FILES-1);
         params[SAMPLE_PARAM].setValue(1.0f);
-        clip_names_[getClipIndex()] = "Recording...";
-        clip_cache_[getClipIndex()].startRec(sampleRate);
+        clip_index_ = getClipIndex();
+        record_index_ = clip_index_;
+
+        clip->startRec(sampleRate, inputs[AUDIO_INPUT].getChannels());
+        recording_clip_.store(clip);
+        return true;
     }
 
     void stopRecord() {
         recording_ = false;
-        const std::string save_baseName = "Record";
-        clip_names_[getClipIndex()] = save_baseName;
-        clip_cache_[getClipIndex()].calculateWaveform();
+        AudioClip *clip = recording_clip_.load();
+        clip->setName("Record");
+        clip->stopRec();
+        clips_.publish(record_index_, clip);
+        recording_clip_.store(nullptr);
+        analysis_worker_.request(record_index_);
+        wavetable_key_ = -1;
     }
 
     void switchRec(int sampleRate) {
-        if (!recording_)
-            startRecord(sampleRate);
+        if (looper_mode_)
+            looper_.toggle();
+        else if (arm_recording_ && !recording_) {
+            armed_ ^= true;
+            record_enabled_ = true;
+            pre_roll_.clear();
+        }
+        else if (!recording_) {
+            record_enabled_ = true;
+            record_pending_ = !startRecord(sampleRate) && !record_pending_;
+        }
         else
             stopRecord();
     }
 
     void saveClip() {
         if (directory_ != "") {
-            const std::string save_baseName = clip_names_[getClipIndex()] + "_" + std::to_string((int)(clip_count_ + 1));
+            const std::string save_baseName = getClip(getClipIndex()).getName() + "_" + std::to_string((int)(clip_count_ + 1));
             const std::string save_filename = save_baseName + ".wav";
             const std::string save_path = directory_ + "/" + save_filename;
-            clip_cache_[getClipIndex()].saveToDisk(save_path);
+            getClip(getClipIndex()).saveToDisk(save_path);
             setPath(save_path, true);
         }
     }
@@ -293,39 +1234,99 @@ struct AdvancedSampler : Module {
     }
 
     inline float calculatePhaseParam(float param) {
-        if (slice_)
+        if (slice_mode_ == EQUAL_SLICES)
             return nearbyint(param * slice_division_) / slice_division_;
 
+        if (slice_mode_ == TRANSIENT_SLICES) {
+            AudioClip &clip = getClip(clip_index_);
+            SliceTable &slices = clip.getSlices();
+            if (slices.count_ > 0 && clip.isLoaded())
+                return (float)slices.getBoundary(nearbyint(param * slices.count_)) / clip.getSampleCount();
+            return param;
+        }
+
         // Fine tune start end
-        if (clip_cache_[getClipIndex()].getSeconds() < 2.0f)
+        if (getClip(clip_index_).getSeconds() < 2.0f)
             return powf(param, 2);
 
         return param;
     }
 
+    inline float snapToZeroCrossing(float phase) {
+        if (!snap_zero_crossings_)
+            return phase;
+
+        AudioClip &clip = getClip(clip_index_);
+        const unsigned int count = clip.getSampleCount();
+        if (count == 0)
+            return phase;
+
+        return (float)clip.getNearestZeroCrossing(phase * count) / count;
+    }
+
     inline float getPhaseStart() {
-        return calculatePhaseParam(getParamModulated(START_PARAM, 0.1f));
+        return snapToZeroCrossing(calculatePhaseParam(getParamModulated(START_PARAM, 0.1f)));
     }
 
     inline float getPhaseEnd() {
-        return calculatePhaseParam(getParamModulated(END_PARAM, 0.1f));
+        return snapToZeroCrossing(calculatePhaseParam(getParamModulated(END_PARAM, 0.1f)));
     }
 
     inline float getPhase() {
         return phase_;
     }
 
-    inline int getClipIndex() {
+    inline bool isKeymapped() {
+        return keymap_ && keymap_clip_ >= 0 && keymap_clip_ < clip_count_;
+    }
+
+    // Clip under the SAMPLE knob, or the keymapped one.
+    inline int getBaseClipIndex() {
+        if (isKeymapped())
+            return keymap_clip_;
+
         float sample_param = getParamModulated(SAMPLE_PARAM, 0.1f);
         return sample_param * clamp(clip_count_ - 1, 0, clip_count_);
     }
 
+    // The last triggered group member, while the base clip stays in its group.
+    inline int getClipIndex() {
+        const int base = getBaseClipIndex();
+        ClipGroups &groups = getGroups();
+        if (clip_groups_ && group_clip_ >= 0 && group_clip_ < clip_count_ && groups.getGroup(group_clip_) == groups.getGroup(base))
+            return group_clip_;
+
+        return base;
+    }
+
+    // The display follows the looper once it holds audio.
+    inline bool isLooperShown() {
+        return looper_mode_ && !looper_.isEmpty();
+    }
+
     inline std::string getClipName() {
-        return clip_names_[getClipIndex()];
+        if (isLooperShown()) {
+            const std::string labels[] = { "Looper", "Looper: rec", "Looper: play", "Looper: dub" };
+            return labels[looper_.getState()];
+        }
+        AudioClip *recording = recording_clip_.load();
+        return recording ? recording->getName() : getClip(getClipIndex()).getName();
     }
 
     inline float* getClipWaveform() {
-        return clip_cache_[getClipIndex()].waveform();
+        if (isLooperShown())
+            return looper_.getWaveform();
+        AudioClip *recording = recording_clip_.load();
+        return recording ? recording->waveform() : getClip(getClipIndex()).waveform();
+    }
+
+    // Peaks of the clip on display. Null while a recording or the looper is
+    // shown, or until the analysis worker built them.
+    inline PeakPyramid *getClipPeaks() {
+        if (isLooperShown() || recording_clip_.load())
+            return nullptr;
+        PeakPyramid &peaks = getClip(getClipIndex()).getPeaks();
+        return peaks.getLevelCount() > 0 ? &peaks : nullptr;
     }
 
     void trimSample() {
@@ -336,55 +1337,257 @@ struct AdvancedSampler : Module {
         if (start_phase > end_phase)
             std::swap(start_phase, end_phase);
 
-        clip_cache_[getClipIndex()].trim(start_phase, end_phase);
+        const int index = getClipIndex();
+        AudioClip *clip = new AudioClip();
+        clip->trim(getClip(index), start_phase, end_phase);
+        clips_.publish(index, clip);
+        analysis_worker_.request(index);
+        wavetable_key_ = -1;
+        analysis_worker_.wake();
     }
 
     /* Folder loading */
 
     static const int MAX_FILES = 256;
 
-    std::vector<std::string> clip_names_;
-    std::vector<std::string> clip_long_names_;
-    std::vector<AudioClip> clip_cache_;
+    // Published clips. Replacing one never frees memory a reader still uses.
+    ClipSlots<MAX_FILES> clips_;
     std::string directory_ = "";
-    int clip_count_ = 0;
+    std::atomic<int> clip_count_{0};
+
+    // Audio thread only, the display reads its name and waveform.
+    std::atomic<AudioClip*> recording_clip_{nullptr};
+    int record_index_ = 0;
+
+    // Taken by startRecord(), replaced by the analysis worker after each
+    // recording. Nothing is allocated until REC, arm or looper mode is first used.
+    std::atomic<AudioClip*> record_spare_{nullptr};
+    std::atomic<bool> record_enabled_{false};
+    int record_spare_channels_ = 0;  // Worker thread only.
+
+    // Worker thread only. Sized for the connected channels in whole float_4s,
+    // replaced by a bigger spare when that count grows, never shrunk.
+    void prepareRecordSpare() {
+        if (!record_enabled_.load())
+            return;
 
-    void initializeClipCache() {
-        for (size_t i = 0; i < MAX_FILES; i++) {
-            clip_cache_.push_back(AudioClip());
-            clip_names_.push_back("Load folder");
-        }
+        const int connected = (clamp(inputs[AUDIO_INPUT].getChannels(), 1, (int)AudioClip::MAX_CHANNELS) + 3) / 4 * 4;
+        if (record_spare_.load() && connected <= record_spare_channels_)
+            return;
+
+        AudioClip *clip = new AudioClip();
+        record_spare_channels_ = std::max(connected, record_spare_channels_);
+        clip->allocateRec(record_spare_channels_);
+        clip->setName("Recording...");
+        delete record_spare_.exchange(clip);
     }
 
-    void setPath(std::string path, bool force_reload) {
-        const std::string directory = system::getDirectory(path);
-        setDirectory(directory, force_reload);
+    AudioClip &getClip(int index) {
+        return clips_.get(index);
     }
 
-    void setDirectory(std::string directory, bool force_reload) {
-        playing_ = false;
-        loadDirectory(directory, force_reload);
+    /* Keymap */
+
+    // Root notes from the smpl chunk, the file name, or else the detected
+    // pitch. The analysis worker owns them and is the only keymap publisher,
+    // once per pass.
+    int clip_root_notes_[MAX_FILES];
+    bool keymap_dirty_ = false;
+    std::atomic<bool> keymap_requested_{false};
+    KeyMap keymaps_[2];
+    std::atomic<int> keymap_index_{0};
+    int keymap_clip_ = -1;
+    int keymap_root_ = 60;
+
+    KeyMap &getKeymap() {
+        return keymaps_[keymap_index_.load(std::memory_order_acquire)];
     }
 
-    void loadDirectory(std::string directory, bool force_reload) {
-        if (directory_ == directory && !force_reload)
+    // Builds the spare map and swaps it in. Worker thread only.
+    void publishKeymap() {
+        const int back = 1 - keymap_index_;
+        keymaps_[back].build(clip_root_notes_, clip_count_);
+        keymap_index_.store(back, std::memory_order_release);
+    }
+
+    // Worker thread only.
+    void setRootNote(int index, int root) {
+        if (clip_root_notes_[index] == root)
             return;
 
-        // First two entries are:
-        // .
-        // ..
-        DIR *dir;
+        clip_root_notes_[index] = root;
+        keymap_dirty_ = true;
+    }
 
-        if ((dir = opendir(directory.c_str())) == NULL)
-            return;
+    /* Round robin & velocity layers */
 
-        directory_ = directory;
+    // Every member is already published, selection never loads.
+    ClipGroups groups_[2];
+    std::atomic<int> groups_index_{0};
+    int group_clip_ = -1;
+
+    ClipGroups &getGroups() {
+        return groups_[groups_index_.load(std::memory_order_acquire)];
+    }
+
+    // Builds the spare groups and swaps them in, like the keymap. Not from the audio thread.
+    void publishGroups(const std::vector<std::string> &names) {
+        const int back = 1 - groups_index_;
+        groups_[back].build(names);
+        groups_index_.store(back, std::memory_order_release);
+    }
+
+    /* Background analysis */
+
+    AnalysisWorker<MAX_FILES> analysis_worker_;
+    OnsetDetector onset_detector_;
+    PitchDetector pitch_detector_;
+    ClipIndex metadata_index_;
+
+    // Worker thread only.
+    void analyzeClip(int index) {
+        ClipSlots<MAX_FILES>::ReadGuard clip_guard(clips_, ClipSlots<MAX_FILES>::ANALYSIS_READER);
+        AudioClip *published = &getClip(index);
+
+        // Recordings are published as recorded. Swap in a tight copy with its
+        // guards, unless the slot changed meanwhile and has a request of its own.
+        if (published->hasRecordSpace()) {
+            AudioClip *compact = new AudioClip();
+            compact->trim(*published, 0.0, 1.0);
+            if (!clips_.replace(index, published, compact)) {
+                delete compact;
+                return;
+            }
+            published = compact;
+        }
+
+        AudioClip &clip = *published;
+        if (!clip.isLoaded()) {
+            setRootNote(index, KeyMap::NO_ROOT);
+            return;
+        }
+
+        // First, the display is waiting for it.
+        clip.buildPeaks();
+
+        clip.buildZeroCrossings();
+        clip.buildDecimated();
+
+        SliceTable slices;
+        onset_detector_.detect(clip.data(), clip.getSampleCount(), clip.getSampleRate(), slices);
+        clip.publishSlices(slices);
+
+        Loudness loudness;
+        loudness.measure(clip.data(), clip.getSampleCount(), clip.getSampleRate());
+        clip.publishLoudness(loudness);
+
+        // -40dB.
+        const float *data = clip.data();
+        uint32_t attack = 0;
+        while (attack < clip.getSampleCount() && fabsf(data[attack]) < 0.01f)
+            attack++;
+        clip.publishAttackOffset(attack < clip.getSampleCount() ? attack : 0);
+
+        // Tempo and pitch, from the folder index unless the file changed.
+        ClipIndex::Entry entry;
+        if (!metadata_index_.lookup(clip.getPath(), entry)) {
+            entry.bpm = TempoEstimator::estimate(onset_detector_.getFlux(), (float)OnsetDetector::HOP_SIZE / clip.getSampleRate(), clip.getSeconds());
+            entry.pitch = pitch_detector_.detect(clip.data(), clip.getSampleCount(), clip.getSampleRate(), attack + clip.getSampleRate() / 50);
+            metadata_index_.store(clip.getPath(), entry);
+        }
+        clip.publishMetadata(entry.bpm, entry.pitch);
+
+        // Detected pitch is the root note of last resort.
+        int root = clip.getRootNote();
+        if (root == KeyMap::NO_ROOT && entry.pitch > 0)
+            root = clamp((int)roundf(69 + 12 * log2f(entry.pitch / 440.0f)), 0, KeyMap::NUM_NOTES - 1);
+        setRootNote(index, root);
+    }
+
+    /* Wavetable */
+
+    // Built on its own worker and swapped in when done. The audio thread
+    // latches the front table at control rate and acknowledges it in
+    // wavetable_reading_. The worker only rebuilds a table nobody latched.
+    Wavetable wavetables_[2];
+    std::atomic<int> wavetable_index_{0};
+    std::atomic<int> wavetable_reading_{0};
+    int wavetable_read_index_ = 0;
+    std::atomic<int> wavetable_key_{-1};  // Requested clip, frames and mipmaps. -1 when stale.
+    AnalysisWorker<1> wavetable_worker_;
+    int wavetable_frames_ = 0;  // 0: Frames of TABLE_SIZE samples.
+    float wavetable_phase_ = 0;
+    float wavetable_position_ = 0;
+
+    int getWavetableKey() {
+        return (clip_index_ * (Wavetable::MAX_FRAMES + 1) + wavetable_frames_) * 2 + use_mipmaps_;
+    }
+
+    // Worker thread only.
+    void buildWavetable() {
+        const int key = wavetable_key_;
+        if (key < 0)
+            return;
+
+        ClipSlots<MAX_FILES>::ReadGuard clip_guard(clips_, ClipSlots<MAX_FILES>::WAVETABLE_READER);
+        AudioClip &clip = getClip(key / 2 / (Wavetable::MAX_FRAMES + 1));
+        if (!clip.isLoaded())
+            return;
+
+        const int count = clip.getSampleCount();
+        // Auto splits in TABLE_SIZE cycles, build() keeps up to MAX_FRAMES of them.
+        int frames = key / 2 % (Wavetable::MAX_FRAMES + 1);
+        if (frames == 0)
+            frames = count % Wavetable::TABLE_SIZE == 0 ? count / Wavetable::TABLE_SIZE : 1;
+
+        // The audio thread still reads the previous table. Retry at the next poll.
+        const int back = 1 - wavetable_index_;
+        if (wavetable_reading_.load(std::memory_order_acquire) == back) {
+            wavetable_worker_.request(0);
+            return;
+        }
+
+        wavetables_[back].build(clip.data(), count, frames, (key & 1) ? Wavetable::MAX_LEVELS : 1);
+        wavetable_index_.store(back, std::memory_order_release);
+    }
+
+    // Nothing reads the clips yet.
+    void initializeClipCache() {
+        for (size_t i = 0; i < MAX_FILES; i++) {
+            getClip(i).setName("Load folder");
+            clip_root_notes_[i] = KeyMap::NO_ROOT;
+        }
+    }
+
+    void setPath(std::string path, bool force_reload) {
+        const std::string directory = system::getDirectory(path);
+        setDirectory(directory, force_reload);
+    }
+
+    void setDirectory(std::string directory, bool force_reload) {
+        playing_ = false;
+        loadDirectory(directory, force_reload);
+    }
+
+    void loadDirectory(std::string directory, bool force_reload) {
+        if (directory_ == directory && !force_reload)
+            return;
+
+        // First two entries are:
+        // .
+        // ..
+        DIR *dir;
+
+        if ((dir = opendir(directory.c_str())) == NULL)
+            return;
+
+        directory_ = directory;
 
         struct dirent *ent;
 
-        clip_names_.clear();
-        clip_long_names_.clear();
-        clip_count_ = 0;
+        // Clips are published one by one, the old ones keep playing meanwhile.
+        std::vector<std::string> clip_long_names;
+        int clip_count = 0;
 
         while ((ent = readdir(dir)) != NULL) {
             std::string fileName = ent->d_name;
@@ -396,18 +1599,38 @@ struct AdvancedSampler : Module {
                     found = fileName.find(".WAV", fileName.length() - 5);
                 }
                 if (found != std::string::npos) {
-                    if (clip_count_ < MAX_FILES) {
+                    if (clip_count < MAX_FILES) {
                         std::string clip_long_name = system::getStem(system::getFilename(fileName));
                         std::string clip_short_name = shorten_string(clip_long_name);
                         std::string clip_path = directory + "/" + clip_long_name + ".wav";
-                         clip_cache_[clip_count_].load(clip_path);
-                        clip_names_.push_back(clip_short_name);
-                        clip_long_names_.push_back(clip_long_name);
-                        clip_count_++;
+                        AudioClip *clip = new AudioClip();
+                        clip->load(clip_path);
+                        clip->setName(clip_short_name);
+                        int root = KeyMap::readSmplRootNote(clip_path);
+                        if (root == KeyMap::NO_ROOT)
+                            root = KeyMap::parseNoteName(clip_long_name);
+                        clip->setRootNote(root);
+                        clips_.publish(clip_count, clip);
+                        analysis_worker_.request(clip_count);
+                        clip_long_names.push_back(clip_long_name);
+                        clip_count++;
                     }
                 }
             }
         }
+
+        clip_count_ = clip_count;
+        clips_.collect();
+
+        analysis_worker_.wake();
+        wavetable_key_ = -1;
+
+        // The worker publishes the keymap once the new roots are in.
+        keymap_requested_ = true;
+        keymap_clip_ = -1;
+
+        publishGroups(clip_long_names);
+        group_clip_ = -1;
     }
 
     static std::string shorten_string(const std::string &text, int maxCharacters = 16) {
@@ -458,14 +1681,150 @@ struct LoadButton : RubberSmallButton
     }
 };
 
-struct SamplerDisplay : TransparentWidget
+// Static layers (background, names, waveform and slices) are rendered into
+// the framebuffer, redrawn only when their LayerState changes. The loop
+// shadow, start, end and play position are drawn on top every frame.
+struct SamplerDisplay : FramebufferWidget
 {
     AdvancedSampler *module;
 
+    // Module state, sampled at the quality tier display rate.
+    float refresh_time_ = 0;
+    float phase_start_ = 0;
+    float phase_end_ = 1;
+    float phase_ = 0;
+    bool playing_ = false;
+
+    // Everything the static layers depend on. No addresses, a freed clip's
+    // memory can come back as a new clip.
+    struct LayerState {
+        uint32_t generation = 0;
+        uint32_t analysis_version = 0;
+        bool peaks = false;
+        int clip_index = -1;
+        int clip_count = 0;
+        int looper_state = 0;
+        int slice_mode = 0;
+        int slice_division = 0;
+
+        bool operator==(const LayerState &other) const {
+            return generation == other.generation && analysis_version == other.analysis_version
+                && peaks == other.peaks && clip_index == other.clip_index && clip_count == other.clip_count
+                && looper_state == other.looper_state && slice_mode == other.slice_mode
+                && slice_division == other.slice_division;
+        }
+    };
+    LayerState layer_state_;
+
+    struct StaticLayer : Widget {
+        SamplerDisplay *display;
+        void draw(const DrawArgs &args) override {
+            display->drawStatic(args);
+        }
+    };
+    StaticLayer *static_layer_;
+
+    std::shared_ptr<Font> font_;
+
+    // Peak outline scratch, one per screen pixel.
+    static const int MAX_COLUMNS = 4096;
+    float column_min_[MAX_COLUMNS];
+
     SamplerDisplay() {
+        static_layer_ = new StaticLayer();
+        static_layer_->display = this;
+        addChild(static_layer_);
     }
 
-    void draw(const DrawArgs &args) override {
+    void step() override {
+        static_layer_->box.size = box.size;
+        FramebufferWidget::step();
+
+        if (!module)
+            return;
+
+        // Retired clips are deleted on this thread, so drawing needs no guard.
+        module->clips_.collect();
+
+        refresh_time_ += APP->window->getLastFrameDuration();
+        if (refresh_time_ < module->ui_update_time_)
+            return;
+
+        refresh_time_ = 0;
+        if (module->isLooperShown()) {
+            phase_start_ = 0;
+            phase_end_ = 1;
+            phase_ = module->looper_.getPhase();
+            playing_ = module->looper_.getState() != Looper::RECORDING;
+        }
+        else {
+            phase_start_ = module->getPhaseStart();
+            phase_end_ = module->getPhaseEnd();
+            phase_ = module->getPhase();
+            playing_ = module->playing_;
+        }
+
+        // Recordings and the looper redraw at the display rate, the rest on change.
+        LayerState state;
+        const int clip_index = module->getClipIndex();
+        AudioClip &clip = module->getClip(clip_index);
+        state.generation = clip.getGeneration();
+        state.analysis_version = clip.getAnalysisVersion();
+        state.peaks = module->getClipPeaks() != nullptr;
+        state.clip_index = clip_index;
+        state.clip_count = module->clip_count_;
+        state.looper_state = module->isLooperShown() ? module->looper_.getState() : -1;
+        state.slice_mode = module->slice_mode_;
+        state.slice_division = module->slice_division_;
+
+        const bool live = module->isLooperShown() || module->recording_clip_.load();
+        if (live || !(state == layer_state_)) {
+            layer_state_ = state;
+            setDirty();
+        }
+    }
+
+    // Waveform area below the clip name.
+    void getWaveformRect(Vec *origin, Vec *size) {
+        const float font_heigth = 6;
+        const float waveform_text_margin = 4;
+        const Vec screen_margin = Vec(4, 4);
+        *size = Vec(box.size.x - screen_margin.x * 2, box.size.y - screen_margin.y * 2 - font_heigth - waveform_text_margin);
+        *origin = Vec(screen_margin.x, box.size.y / 2 + font_heigth / 2 + waveform_text_margin / 2);
+    }
+
+    // Min/max outline, one column per screen pixel at the current zoom. The
+    // pyramid level is the coarsest with a bin per column, so this is O(pixels).
+    void drawPeaks(const DrawArgs &args, PeakPyramid &peaks, Vec origin, Vec size) {
+        float transform[6];
+        nvgCurrentTransform(args.vg, transform);
+        const int columns = clamp((int)ceilf(size.x * transform[0]), 2, (int)MAX_COLUMNS);
+        const int level = peaks.getLevel(columns);
+        const int bins = PeakPyramid::getBins(level);
+
+        // Scale the loudest peak to 80% like the averaged waveform.
+        float lo, hi;
+        peaks.getRange(0, 0, PeakPyramid::MIN_BINS, &lo, &hi);
+        const float scale = 0.8f * size.y / 2 / std::max(std::max(-lo, hi), 1e-6f);
+
+        nvgBeginPath(args.vg);
+        for (int c = 0; c < columns; c++) {
+            const int start = (int64_t)c * bins / columns;
+            const int end = std::max((int)((int64_t)(c + 1) * bins / columns), start + 1);
+            peaks.getRange(level, start, end, &lo, &hi);
+            column_min_[c] = lo;
+            const float x = origin.x + size.x * c / (columns - 1);
+            if (c == 0)
+                nvgMoveTo(args.vg, x, origin.y - hi * scale);
+            else
+                nvgLineTo(args.vg, x, origin.y - hi * scale);
+        }
+        for (int c = columns - 1; c >= 0; c--)
+            nvgLineTo(args.vg, origin.x + size.x * c / (columns - 1), origin.y - column_min_[c] * scale);
+        nvgClosePath(args.vg);
+    }
+
+    void drawStatic(const DrawArgs &args) {
         // Background
         NVGcolor backgroundColor = nvgRGB(0x18, 0x18, 0x18);
         NVGcolor borderColor = nvgRGB(0x08, 0x08, 0x08);
@@ -480,15 +1839,15 @@ struct SamplerDisplay : TransparentWidget
         if (!module)
             return;
 
-        std::shared_ptr<Font> font = APP->window->loadFont(asset::plugin(pluginInstance, "res/Fonts/FiraMono-Bold.ttf"));
+        if (!font_)
+            font_ = APP->window->loadFont(asset::plugin(pluginInstance, "res/Fonts/FiraMono-Bold.ttf"));
         float font_heigth = 6;
-        float waveform_text_margin = 4;
         Vec screen_margin = Vec(4, 4);
-        if (font) {
+        if (font_) {
             const NVGcolor text_color = nvgRGB(44, 175, 210);
             nvgFillColor(args.vg, text_color);
             nvgFontSize(args.vg, 10);
-            nvgFontFaceId(args.vg, font->handle);
+            nvgFontFaceId(args.vg, font_->handle);
             nvgTextLetterSpacing(args.vg, 1);
 
             // Clip name
@@ -504,53 +1863,76 @@ struct SamplerDisplay : TransparentWidget
         }
 
         // Waveform
-        const Vec waveform_size = Vec(box.size.x - screen_margin.x * 2, box.size.y - screen_margin.y * 2 - font_heigth - waveform_text_margin);
+        Vec waveform_origin, waveform_size;
+        getWaveformRect(&waveform_origin, &waveform_size);
         const Vec half_waveform_size = waveform_size.div(2);
-        const Vec waveform_origin = Vec(screen_margin.x, box.size.y / 2 + font_heigth / 2 + waveform_text_margin / 2);
         const NVGcolor waveform_fill_color = nvgRGB(11, 44, 52);
         const NVGcolor waveform_stroke_color = nvgRGB(44, 175, 210);
-        float *points = module->getClipWaveform();
-        nvgBeginPath(args.vg);
-        nvgMoveTo(args.vg, waveform_origin.x, waveform_origin.y);
-        for (size_t i = 0; i < WAVEFORM_RESOLUTION; i++)
-            nvgLineTo(args.vg, waveform_origin.x + i * (waveform_size.x / WAVEFORM_RESOLUTION), waveform_origin.y - points[i] * half_waveform_size.y);
-        nvgLineTo(args.vg, waveform_origin.x + waveform_size.x, waveform_origin.y);
-        for (size_t i = WAVEFORM_RESOLUTION; i > 0; i--)
-            nvgLineTo(args.vg, waveform_origin.x + (i-1) * (waveform_size.x / WAVEFORM_RESOLUTION), waveform_origin.y + points[i-1] * half_waveform_size.y);
-        nvgLineTo(args.vg, waveform_origin.x, waveform_origin.y);
+        PeakPyramid *peaks = module->getClipPeaks();
+        if (peaks) {
+            drawPeaks(args, *peaks, waveform_origin, waveform_size);
+        }
+        else {
+            float *points = module->getClipWaveform();
+            nvgBeginPath(args.vg);
+            nvgMoveTo(args.vg, waveform_origin.x, waveform_origin.y);
+            for (size_t i = 0; i < WAVEFORM_RESOLUTION; i++)
+                nvgLineTo(args.vg, waveform_origin.x + i * (waveform_size.x / WAVEFORM_RESOLUTION), waveform_origin.y - points[i] * half_waveform_size.y);
+            nvgLineTo(args.vg, waveform_origin.x + waveform_size.x, waveform_origin.y);
+            for (size_t i = WAVEFORM_RESOLUTION; i > 0; i--)
+                nvgLineTo(args.vg, waveform_origin.x + (i-1) * (waveform_size.x / WAVEFORM_RESOLUTION), waveform_origin.y + points[i-1] * half_waveform_size.y);
+            nvgLineTo(args.vg, waveform_origin.x, waveform_origin.y);
+        }
         nvgFillColor(args.vg, waveform_fill_color);
         nvgFill(args.vg);
         nvgStrokeColor(args.vg, waveform_stroke_color);
         nvgStroke(args.vg);
 
-        // Loop shadow
-        float phase_start = module->getPhaseStart();
-        float phase_end   = module->getPhaseEnd();
-        float min = std::min(phase_start, phase_end);
-        float max = std::max(phase_start, phase_end);
-        const NVGcolor shadow_color = nvgTransRGBA(backgroundColor, 128);
-        nvgBeginPath(args.vg);
-        nvgRect(args.vg, waveform_origin.x, waveform_origin.y - half_waveform_size.y, waveform_size.x * min, waveform_size.y);
-        nvgRect(args.vg, waveform_origin.x + waveform_size.x * max, waveform_origin.y - half_waveform_size.y, waveform_size.x * (1 - max), waveform_size.y);
-        nvgFillColor(args.vg, shadow_color);
-        nvgFill(args.vg);
-
         // Draw slices
-        if (module->slice_) {
+        if (module->slice_mode_ != NO_SLICES) {
             nvgBeginPath(args.vg);
-            int slices = module->slice_division_;
-            float slice_size = waveform_size.x / slices;
+            AudioClip &clip = module->getClip(module->getClipIndex());
+            SliceTable &table = clip.getSlices();
+            bool transients = module->slice_mode_ == TRANSIENT_SLICES && table.count_ > 0 && clip.isLoaded();
+            int slices = transients ? table.count_ : module->slice_division_;
             for (int i = 0; i < slices + 1; i++) {
-                nvgMoveTo(args.vg, waveform_origin.x + slice_size * i, waveform_origin.y - half_waveform_size.y);
-                nvgLineTo(args.vg, waveform_origin.x + slice_size * i, waveform_origin.y - waveform_size.y * .33f);
-
-                nvgMoveTo(args.vg, waveform_origin.x + slice_size * i, waveform_origin.y + half_waveform_size.y);
-                nvgLineTo(args.vg, waveform_origin.x + slice_size * i, waveform_origin.y + waveform_size.y * .33f);
+                float x = transients
+                          ? waveform_size.x * table.getBoundary(i) / clip.getSampleCount()
+                          : waveform_size.x * i / slices;
+                nvgMoveTo(args.vg, waveform_origin.x + x, waveform_origin.y - half_waveform_size.y);
+                nvgLineTo(args.vg, waveform_origin.x + x, waveform_origin.y - waveform_size.y * .33f);
+
+                nvgMoveTo(args.vg, waveform_origin.x + x, waveform_origin.y + half_waveform_size.y);
+                nvgLineTo(args.vg, waveform_origin.x + x, waveform_origin.y + waveform_size.y * .33f);
             }
             const NVGcolor slice_color = nvgRGB(22, 75, 105);
             nvgStrokeColor(args.vg, slice_color);
             nvgStroke(args.vg);
         }
+    }
+
+    void draw(const DrawArgs &args) override {
+        FramebufferWidget::draw(args);
+
+        if (!module)
+            return;
+
+        Vec waveform_origin, waveform_size;
+        getWaveformRect(&waveform_origin, &waveform_size);
+        const Vec half_waveform_size = waveform_size.div(2);
+        const NVGcolor waveform_stroke_color = nvgRGB(44, 175, 210);
+
+        // Loop shadow
+        float phase_start = phase_start_;
+        float phase_end   = phase_end_;
+        float min = std::min(phase_start, phase_end);
+        float max = std::max(phase_start, phase_end);
+        const NVGcolor shadow_color = nvgTransRGBA(nvgRGB(0x18, 0x18, 0x18), 128);
+        nvgBeginPath(args.vg);
+        nvgRect(args.vg, waveform_origin.x, waveform_origin.y - half_waveform_size.y, waveform_size.x * min, waveform_size.y);
+        nvgRect(args.vg, waveform_origin.x + waveform_size.x * max, waveform_origin.y - half_waveform_size.y, waveform_size.x * (1 - max), waveform_size.y);
+        nvgFillColor(args.vg, shadow_color);
+        nvgFill(args.vg);
 
         // Draw start end positions.
         nvgBeginPath(args.vg);
@@ -560,16 +1942,15 @@ struct SamplerDisplay : TransparentWidget
         nvgLineTo(args.vg, waveform_origin.x + phase_end   * waveform_size.x, waveform_origin.y + half_waveform_size.y);
 
         // Draw play position.
-        if (module->playing_) {
-            float phase = module->getPhase();
+        if (playing_) {
+            float phase = phase_;
             nvgMoveTo(args.vg, waveform_origin.x + phase * waveform_size.x, waveform_origin.y - half_waveform_size.y);
             nvgLineTo(args.vg, waveform_origin.x + phase * waveform_size.x, waveform_origin.y + half_waveform_size.y);
         }
 
         nvgStrokeColor(args.vg, waveform_stroke_color);
+        nvgStrokeWidth(args.vg, 1.0);
         nvgStroke(args.vg);
-
-        return;
     }
 };
 
@@ -653,6 +2034,116 @@ struct AdvancedSamplerWidget : ModuleWidget
             }
         };
 
+        struct PlayModeIndexItem : MenuItem {
+            AdvancedSampler *module;
+            PlayModes mode;
+            void onAction(const event::Action &e) override {
+                module->play_mode_ = mode;
+            }
+        };
+
+        struct PlayModeItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                const std::string playModeLabels[] = { "Sampler", "Granular", "Time stretch", "Wavetable", "Scrub" };
+                for (int i = 0; i < (int)LENGTHOF(playModeLabels); i++) {
+                    PlayModeIndexItem *item = createMenuItem<PlayModeIndexItem>(playModeLabels[i], CHECKMARK(module->play_mode_ == (PlayModes)i));
+                    item->module = module;
+                    item->mode = (PlayModes)i;
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
+        struct ParamSlider : ui::Slider {
+            ParamSlider(ParamQuantity *param_quantity) {
+                quantity = param_quantity;
+                box.size.x = 200.0f;
+            }
+        };
+
+        struct GranularItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                menu->addChild(createMenuLabel("START: position, END: grain size"));
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::GRAIN_DENSITY_PARAM]));
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::GRAIN_SPRAY_PARAM]));
+                return menu;
+            }
+        };
+
+        struct StretchItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                menu->addChild(createMenuLabel("TUNE: pitch only"));
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::STRETCH_PARAM]));
+                return menu;
+            }
+        };
+
+        struct ScrubItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                menu->addChild(createMenuLabel("START + CV: read position"));
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::SCRUB_SMOOTH_PARAM]));
+                return menu;
+            }
+        };
+
+        struct WavetableFramesIndexItem : MenuItem {
+            AdvancedSampler *module;
+            int frames;
+            void onAction(const event::Action &e) override {
+                module->wavetable_frames_ = frames;
+            }
+        };
+
+        struct WavetableItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                menu->addChild(createMenuLabel("START: frame position"));
+                menu->addChild(createMenuLabel("Frames"));
+                const int frames[] = {0, 1, 2, 4, 8, 16, 32, 64};
+                for (int i = 0; i < (int)LENGTHOF(frames); i++) {
+                    const std::string label = frames[i] == 0 ? "Auto (2048 samples each)" : std::to_string(frames[i]);
+                    WavetableFramesIndexItem *item = createMenuItem<WavetableFramesIndexItem>(label, CHECKMARK(module->wavetable_frames_ == frames[i]));
+                    item->module = module;
+                    item->frames = frames[i];
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
+        struct LoopModeIndexItem : MenuItem {
+            AdvancedSampler *module;
+            LoopModes mode;
+            void onAction(const event::Action &e) override {
+                module->loop_mode_ = mode;
+            }
+        };
+
+        struct LoopModeItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                const std::string loopModeLabels[] = { "Forward", "Reverse", "Ping-pong" };
+                for (int i = 0; i < (int)LENGTHOF(loopModeLabels); i++) {
+                    LoopModeIndexItem *item = createMenuItem<LoopModeIndexItem>(loopModeLabels[i], CHECKMARK(module->loop_mode_ == (LoopModes)i));
+                    item->module = module;
+                    item->mode = (LoopModes)i;
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
         struct EnvelopeIndexItem : MenuItem {
             AdvancedSampler *module;
             bool hold;
@@ -676,23 +2167,341 @@ struct AdvancedSamplerWidget : ModuleWidget
             }
         };
 
+        struct SliceIndexItem : MenuItem {
+            AdvancedSampler *module;
+            SliceModes mode;
+            void onAction(const event::Action &e) override {
+                module->slice_mode_ = mode;
+            }
+        };
+
         struct SliceItem : MenuItem {
             AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                const std::string sliceLabels[] = { "Off", "Equal", "Transients" };
+                for (int i = 0; i < (int)LENGTHOF(sliceLabels); i++) {
+                    SliceIndexItem *item = createMenuItem<SliceIndexItem>(sliceLabels[i], CHECKMARK(module->slice_mode_ == (SliceModes)i));
+                    item->module = module;
+                    item->mode = (SliceModes)i;
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
+        struct ControlRateIndexItem : MenuItem {
+            AdvancedSampler *module;
+            int division;
+            void onAction(const event::Action &e) override {
+                module->control_divider_.setDivision(division);
+            }
+        };
+
+        struct ControlRateItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                const int divisions[] = { 1, 4, 16, 32, 64 };
+                for (int i = 0; i < (int)LENGTHOF(divisions); i++) {
+                    const std::string label = divisions[i] == 1 ? "Every sample" : "Every " + std::to_string(divisions[i]) + " samples";
+                    ControlRateIndexItem *item = createMenuItem<ControlRateIndexItem>(label, CHECKMARK((int)module->control_divider_.getDivision() == divisions[i]));
+                    item->module = module;
+                    item->division = divisions[i];
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
+        struct OversamplingIndexItem : MenuItem {
+            AdvancedSampler *module;
+            int oversampling;
             void onAction(const event::Action &e) override {
-                module->slice_ ^= true;
+                module->setOversampling(oversampling);
+            }
+        };
+
+        struct OversamplingItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                const std::string oversamplingLabels[] = { "Off", "2x", "4x" };
+                const int oversampling[] = { 1, 2, 4 };
+                for (int i = 0; i < (int)LENGTHOF(oversampling); i++) {
+                    OversamplingIndexItem *item = createMenuItem<OversamplingIndexItem>(oversamplingLabels[i], CHECKMARK(module->oversampling_ == oversampling[i]));
+                    item->module = module;
+                    item->oversampling = oversampling[i];
+                    menu->addChild(item);
+                }
+                menu->addChild(new MenuSeparator);
+                menu->addChild(createMenuLabel("Latency: " + std::to_string(module->getLatency()) + " samples"));
+                return menu;
+            }
+        };
+
+        struct TuneInputIndexItem : MenuItem {
+            AdvancedSampler *module;
+            TuneInputModes mode;
+            void onAction(const event::Action &e) override {
+                module->tune_input_mode_ = mode;
+            }
+        };
+
+        struct TuneInputItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                const std::string modeLabels[NUM_TUNE_INPUT_MODES] = {"V/Oct", "V/Oct audio rate (FM)", "Linear FM (through zero)"};
+                for (int i = 0; i < NUM_TUNE_INPUT_MODES; i++) {
+                    TuneInputIndexItem *item = createMenuItem<TuneInputIndexItem>(modeLabels[i], CHECKMARK(module->tune_input_mode_ == i));
+                    item->module = module;
+                    item->mode = (TuneInputModes)i;
+                    menu->addChild(item);
+                }
+                menu->addChild(new MenuSeparator);
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::FM_DEPTH_PARAM]));
+                return menu;
+            }
+        };
+
+        struct QualityIndexItem : MenuItem {
+            AdvancedSampler *module;
+            QualityTiers quality;
+            void onAction(const event::Action &e) override {
+                module->setQuality(quality);
+            }
+        };
+
+        struct QualityItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                for (int i = 0; i < NUM_QUALITY_TIERS; i++) {
+                    QualityIndexItem *item = createMenuItem<QualityIndexItem>(quality_tiers_[i].label, CHECKMARK(module->quality_ == (QualityTiers)i));
+                    item->module = module;
+                    item->quality = (QualityTiers)i;
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
+        struct SliceTriggerIndexItem : MenuItem {
+            AdvancedSampler *module;
+            SliceTriggerModes mode;
+            void onAction(const event::Action &e) override {
+                module->slice_trigger_mode_ = mode;
+            }
+        };
+
+        struct SliceTriggerItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                const std::string sliceTriggerLabels[] = { "Off", "Poly gates (channel = slice)", "Gate + START CV" };
+                for (int i = 0; i < (int)LENGTHOF(sliceTriggerLabels); i++) {
+                    SliceTriggerIndexItem *item = createMenuItem<SliceTriggerIndexItem>(sliceTriggerLabels[i], CHECKMARK(module->slice_trigger_mode_ == (SliceTriggerModes)i));
+                    item->module = module;
+                    item->mode = (SliceTriggerModes)i;
+                    menu->addChild(item);
+                }
+                return menu;
+            }
+        };
+
+        struct NormaliseIndexItem : MenuItem {
+            AdvancedSampler *module;
+            NormaliseModes mode;
+            void onAction(const event::Action &e) override {
+                module->normalise_mode_ = mode;
+            }
+        };
+
+        struct NormaliseItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                const std::string normaliseLabels[] = { "Off", "Peak", "Loudness (-16 LUFS)" };
+                for (int i = 0; i < (int)LENGTHOF(normaliseLabels); i++) {
+                    NormaliseIndexItem *item = createMenuItem<NormaliseIndexItem>(normaliseLabels[i], CHECKMARK(module->normalise_mode_ == (NormaliseModes)i));
+                    item->module = module;
+                    item->mode = (NormaliseModes)i;
+                    menu->addChild(item);
+                }
+
+                AudioClip &clip = module->getClip(module->clip_index_);
+                if (clip.isLoaded() && clip.getPeak() > 0.0f) {
+                    menu->addChild(new MenuSeparator);
+                    menu->addChild(createMenuLabel(string::f("Peak %.1f dB, RMS %.1f dB", 20.0f * log10f(clip.getPeak()), 20.0f * log10f(clip.getRms()))));
+                    menu->addChild(createMenuLabel(string::f("Loudness %.1f LUFS", clip.getLufs())));
+                }
+                return menu;
+            }
+        };
+
+        struct SnapItem : MenuItem {
+            AdvancedSampler *module;
+            void onAction(const event::Action &e) override {
+                module->snap_zero_crossings_ ^= true;
             }
             void step() override {
-                rightText = module->slice_ ? "On" : "Off";
+                rightText = module->snap_zero_crossings_ ? "On" : "Off";
             }
         };
 
-        struct LowCpuItem : MenuItem {
+        struct KeymapItem : MenuItem {
             AdvancedSampler *module;
             void onAction(const event::Action &e) override {
-                module->low_cpu_ ^= true;
+                module->keymap_ ^= true;
+                module->keymap_clip_ = -1;
             }
             void step() override {
-                rightText = module->low_cpu_ ? "On" : "Off";
+                rightText = !module->keymap_ ? "Off" : module->getKeymap().isMapped() ? "On" : "No root notes";
+            }
+        };
+
+        struct ClipGroupsItem : MenuItem {
+            AdvancedSampler *module;
+            void onAction(const event::Action &e) override {
+                module->clip_groups_ ^= true;
+                module->group_clip_ = -1;
+            }
+            void step() override {
+                rightText = module->clip_groups_ ? "On" : "Off";
+            }
+        };
+
+        struct LooperModeItem : MenuItem {
+            AdvancedSampler *module;
+            void onAction(const event::Action &e) override {
+                module->looper_mode_ ^= true;
+                module->record_enabled_ = true;
+            }
+            void step() override {
+                rightText = module->looper_mode_ ? "On" : "Off";
+            }
+        };
+
+        struct LooperClearItem : MenuItem {
+            AdvancedSampler *module;
+            void onAction(const event::Action &e) override {
+                module->looper_.requestClear();
+            }
+        };
+
+        struct LooperItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                menu->addChild(createMenuLabel("REC: record, play, overdub"));
+
+                LooperModeItem *modeItem = createMenuItem<LooperModeItem>("Enabled");
+                modeItem->module = module;
+                menu->addChild(modeItem);
+
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::LOOPER_FEEDBACK_PARAM]));
+
+                LooperClearItem *clearItem = createMenuItem<LooperClearItem>("Clear loop");
+                clearItem->module = module;
+                menu->addChild(clearItem);
+                return menu;
+            }
+        };
+
+        struct ArmRecordingModeItem : MenuItem {
+            AdvancedSampler *module;
+            void onAction(const event::Action &e) override {
+                module->arm_recording_ ^= true;
+                module->record_enabled_ = true;
+            }
+            void step() override {
+                rightText = module->arm_recording_ ? "On" : "Off";
+            }
+        };
+
+        struct ArmRecordingItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                menu->addChild(createMenuLabel("REC arms, the input level starts"));
+
+                ArmRecordingModeItem *modeItem = createMenuItem<ArmRecordingModeItem>("Enabled");
+                modeItem->module = module;
+                menu->addChild(modeItem);
+
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::ARM_THRESHOLD_PARAM]));
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::PRE_ROLL_PARAM]));
+                return menu;
+            }
+        };
+
+        struct MorphItem : MenuItem {
+            AdvancedSampler *module;
+            void onAction(const event::Action &e) override {
+                module->morph_ ^= true;
+            }
+            void step() override {
+                rightText = module->morph_ ? "On" : "Off";
+            }
+        };
+
+        struct FilterIndexItem : MenuItem {
+            AdvancedSampler *module;
+            FilterModes mode;
+            void onAction(const event::Action &e) override {
+                module->filter_mode_ = mode;
+            }
+        };
+
+        struct FilterItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                const std::string filterLabels[NUM_FILTER_MODES] = {"Off", "Low pass", "Band pass", "High pass"};
+                for (int i = 0; i < NUM_FILTER_MODES; i++) {
+                    FilterIndexItem *item = createMenuItem<FilterIndexItem>(filterLabels[i], CHECKMARK(module->filter_mode_ == i));
+                    item->module = module;
+                    item->mode = (FilterModes)i;
+                    menu->addChild(item);
+                }
+                menu->addChild(new MenuSeparator);
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::FILTER_CUTOFF_PARAM]));
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::FILTER_RESONANCE_PARAM]));
+                menu->addChild(new ParamSlider(module->paramQuantities[AdvancedSampler::FILTER_ENV_PARAM]));
+                return menu;
+            }
+        };
+
+        struct SyncIndexItem : MenuItem {
+            AdvancedSampler *module;
+            int beats;
+            void onAction(const event::Action &e) override {
+                module->sync_beats_ = beats;
+                module->sync_beat_ = 0;
+            }
+        };
+
+        struct SyncItem : MenuItem {
+            AdvancedSampler *module;
+            Menu *createChildMenu() override {
+                Menu *menu = new Menu();
+                menu->addChild(createMenuLabel("PLAY input is the clock"));
+                const float bpm = module->getClip(module->clip_index_).getBpm();
+                menu->addChild(createMenuLabel(bpm > 0 ? string::f("Detected tempo: %.1f BPM", bpm) : "No tempo detected"));
+                const int beats[] = {0, -1, 1, 2, 4, 8, 16, 32};
+                for (int i = 0; i < (int)LENGTHOF(beats); i++) {
+                    std::string label = std::to_string(beats[i]) + (beats[i] == 1 ? " beat" : " beats");
+                    if (beats[i] == 0)
+                        label = "Off";
+                    else if (beats[i] < 0)
+                        label = "Auto (detected tempo)";
+                    SyncIndexItem *item = createMenuItem<SyncIndexItem>(label, CHECKMARK(module->sync_beats_ == beats[i]));
+                    item->module = module;
+                    item->beats = beats[i];
+                    menu->addChild(item);
+                }
+                return menu;
             }
         };
 
@@ -712,6 +2521,50 @@ struct AdvancedSamplerWidget : ModuleWidget
 
         menu->addChild(new MenuSeparator);
 
+        PlayModeItem *playModeItem = createMenuItem<PlayModeItem>("Play mode", RIGHT_ARROW);
+        playModeItem->module = module;
+        menu->addChild(playModeItem);
+
+        GranularItem *granularItem = createMenuItem<GranularItem>("Granular", RIGHT_ARROW);
+        granularItem->module = module;
+        menu->addChild(granularItem);
+
+        StretchItem *stretchItem = createMenuItem<StretchItem>("Time stretch", RIGHT_ARROW);
+        stretchItem->module = module;
+        menu->addChild(stretchItem);
+
+        ScrubItem *scrubItem = createMenuItem<ScrubItem>("Scrub", RIGHT_ARROW);
+        scrubItem->module = module;
+        menu->addChild(scrubItem);
+
+        WavetableItem *wavetableItem = createMenuItem<WavetableItem>("Wavetable", RIGHT_ARROW);
+        wavetableItem->module = module;
+        menu->addChild(wavetableItem);
+
+        FilterItem *filterItem = createMenuItem<FilterItem>("Filter", RIGHT_ARROW);
+        filterItem->module = module;
+        menu->addChild(filterItem);
+
+        LooperItem *looperItem = createMenuItem<LooperItem>("Looper", RIGHT_ARROW);
+        looperItem->module = module;
+        menu->addChild(looperItem);
+
+        ArmRecordingItem *armRecordingItem = createMenuItem<ArmRecordingItem>("Armed recording", RIGHT_ARROW);
+        armRecordingItem->module = module;
+        menu->addChild(armRecordingItem);
+
+        LoopModeItem *loopModeItem = createMenuItem<LoopModeItem>("Loop mode", RIGHT_ARROW);
+        loopModeItem->module = module;
+        menu->addChild(loopModeItem);
+
+        SyncItem *syncItem = createMenuItem<SyncItem>("Clock sync", RIGHT_ARROW);
+        syncItem->module = module;
+        menu->addChild(syncItem);
+
+        NormaliseItem *normaliseItem = createMenuItem<NormaliseItem>("Normalise", RIGHT_ARROW);
+        normaliseItem->module = module;
+        menu->addChild(normaliseItem);
+
         EnvelopeItem *holdItem = createMenuItem<EnvelopeItem>("Envelope", RIGHT_ARROW);
         holdItem->module = module;
         menu->addChild(holdItem);
@@ -722,15 +2575,51 @@ struct AdvancedSamplerWidget : ModuleWidget
 
         menu->addChild(new MenuSeparator);
 
-        SliceItem *sliceItem = createMenuItem<SliceItem>("Slice mode");
+        SliceItem *sliceItem = createMenuItem<SliceItem>("Slice mode", RIGHT_ARROW);
         sliceItem->module = module;
         menu->addChild(sliceItem);
 
+        SliceTriggerItem *sliceTriggerItem = createMenuItem<SliceTriggerItem>("Slice triggers", RIGHT_ARROW);
+        sliceTriggerItem->module = module;
+        menu->addChild(sliceTriggerItem);
+
+        SnapItem *snapItem = createMenuItem<SnapItem>("Snap to zero crossings");
+        snapItem->module = module;
+        menu->addChild(snapItem);
+
+        KeymapItem *keymapItem = createMenuItem<KeymapItem>("Keymap (TUNE input picks the clip)");
+        keymapItem->module = module;
+        menu->addChild(keymapItem);
+
+        const float pitch = module->getClip(module->clip_index_).getPitch();
+        if (pitch > 0)
+            menu->addChild(createMenuLabel(string::f("Detected pitch: %.1f Hz", pitch)));
+
+        ClipGroupsItem *clipGroupsItem = createMenuItem<ClipGroupsItem>("Round robin & velocity (AUDIO input)");
+        clipGroupsItem->module = module;
+        menu->addChild(clipGroupsItem);
+
+        MorphItem *morphItem = createMenuItem<MorphItem>("Morph between clips (SAMPLE)");
+        morphItem->module = module;
+        menu->addChild(morphItem);
+
         menu->addChild(new MenuSeparator);
 
-        LowCpuItem *lowCpuItem = createMenuItem<LowCpuItem>("Low cpu mode");
-        lowCpuItem->module = module;
-        menu->addChild(lowCpuItem);
+        QualityItem *qualityItem = createMenuItem<QualityItem>("Quality", RIGHT_ARROW);
+        qualityItem->module = module;
+        menu->addChild(qualityItem);
+
+        ControlRateItem *controlRateItem = createMenuItem<ControlRateItem>("Control rate", RIGHT_ARROW);
+        controlRateItem->module = module;
+        menu->addChild(controlRateItem);
+
+        OversamplingItem *oversamplingItem = createMenuItem<OversamplingItem>("Oversampling", RIGHT_ARROW);
+        oversamplingItem->module = module;
+        menu->addChild(oversamplingItem);
+
+        TuneInputItem *tuneInputItem = createMenuItem<TuneInputItem>("TUNE input", RIGHT_ARROW);
+        tuneInputItem->module = module;
+        menu->addChild(tuneInputItem);
 
         menu->addChild(new MenuSeparator);
 
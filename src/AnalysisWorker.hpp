@@ -0,0 +1,80 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs clip analysis away from the audio thread. request() only stores an
+// atomic flag, so it is safe to call from process(). The worker polls the
+// flags and calls the job for each requested clip, then the optional done
+// callback after every pass.
+template <int SIZE>
+struct AnalysisWorker
+{
+    ~AnalysisWorker()
+    {
+        stop();
+    }
+
+    void start(std::function<void(int)> job, std::function<void()> done = nullptr)
+    {
+        job_ = job;
+        done_ = done;
+        for (int i = 0; i < SIZE; i++)
+            requests_[i] = false;
+        running_ = true;
+        thread_ = std::thread(&AnalysisWorker::run, this);
+    }
+
+    void stop()
+    {
+        if (!running_)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+        }
+        condition_.notify_one();
+        thread_.join();
+    }
+
+    // Lock free. Safe from the audio thread.
+    void request(int index)
+    {
+        requests_[index].store(true, std::memory_order_release);
+    }
+
+    // Wake the worker now instead of at the next poll. Not from the audio thread.
+    void wake()
+    {
+        condition_.notify_one();
+    }
+
+private:
+
+    std::function<void(int)> job_;
+    std::function<void()> done_;
+    std::atomic<bool> requests_[SIZE];
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+
+    void run()
+    {
+        while (running_) {
+            for (int i = 0; i < SIZE && running_; i++)
+                if (requests_[i].exchange(false, std::memory_order_acquire))
+                    job_(i);
+
+            if (done_)
+                done_();
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (running_)
+                condition_.wait_for(lock, std::chrono::milliseconds(50));
+        }
+    }
+};
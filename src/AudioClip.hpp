@@ -1,59 +1,222 @@
 #include "dep/dr_wav/dr_wav.h"
 #include "dsp/Interpolation.hpp"
+#include "dsp/SliceTable.hpp"
+#include "dsp/Loudness.hpp"
+#include "dsp/PeakPyramid.hpp"
+#include "dsp/ZeroCrossings.hpp"
 #define WAVEFORM_RESOLUTION 64
+#define ANALYSIS_DECIMATION 4
 
+// Multichannel clip, one plane per channel. Playback reads channel 0. Planes
+// are stored with GUARD copies of the edge samples on both sides, so
+// interpolation kernels near the ends never leave the buffer.
 struct AudioClip
 {
-    AudioClip() {};
+    static const int GUARD = 4;
+    static const int MAX_CHANNELS = 16;
 
-    unsigned int getSampleCount() { return left_channel_.size(); }
+    AudioClip() {
+        planes_.assign(2 * GUARD, 0.0f);
+    };
+
+    unsigned int getSampleCount() { return sample_count_; }
 
     unsigned int getChannelCount() { return channels_; }
 
     unsigned int getSampleRate() { return sampleRate_; }
 
-    bool isLoaded() { return left_channel_.size() > 0; }
+    bool isLoaded() { return sample_count_ > 0; }
+
+    // Unique per clip object. Caches keyed on it never outlive a reload.
+    uint32_t getGeneration() { return generation_; }
+
+    float getSeconds() { return (float)sample_count_ / (float)sampleRate_; }
+
+    float getSampleTime() { return 1.0f / sample_count_; }
+
+    // GUARD samples are readable before and after.
+    float* data(int channel = 0) { return planes_.data() + channel * stride_ + GUARD; }
 
-    float getSeconds() { return (float)left_channel_.size() / (float)sampleRate_; }
+    // File the data came from. Empty for recordings and trimmed clips.
+    const std::string &getPath() { return path_; }
 
-    float getSampleTime() { return 1.0f / left_channel_.size(); }
+    // Display name. Set before the clip is published.
+    const std::string &getName() { return name_; }
 
-    float* data() { return left_channel_.data(); }
+    void setName(const std::string &name) { name_ = name; }
+
+    // MIDI root from the file, -1 when unknown. Set before the clip is published.
+    int getRootNote() { return root_note_; }
+
+    void setRootNote(int root) { root_note_ = root; }
     
     float* waveform() { return waveform_; }
 
+    // Clip averaged over ANALYSIS_DECIMATION samples. Used for similarity
+    // searches. Built by the analysis worker, double buffered like the slices.
+    // Empty until built.
+    std::vector<float> &getDecimated() {
+        return decimated_[decimated_index_.load(std::memory_order_acquire)];
+    }
+
+    void buildDecimated() {
+        int next = 1 - decimated_index_.load(std::memory_order_relaxed);
+        std::vector<float> &decimated = decimated_[next];
+        const float *samples = data();
+        decimated.resize(sample_count_ / ANALYSIS_DECIMATION);
+        for (size_t i = 0; i < decimated.size(); i++) {
+            float acumulator = 0;
+            for (int s = 0; s < ANALYSIS_DECIMATION; s++)
+                acumulator += samples[i * ANALYSIS_DECIMATION + s];
+            decimated[i] = acumulator / ANALYSIS_DECIMATION;
+        }
+        decimated_index_.store(next, std::memory_order_release);
+    }
+
+    // Indexed zero crossing nearest to a sample index. The index itself until
+    // the analysis worker built them.
+    unsigned int getNearestZeroCrossing(unsigned int index) {
+        return zero_crossings_[zero_crossings_index_.load(std::memory_order_acquire)].getNearest(index);
+    }
+
+    void buildZeroCrossings() {
+        int next = 1 - zero_crossings_index_.load(std::memory_order_relaxed);
+        zero_crossings_[next].build(data(), sample_count_);
+        zero_crossings_index_.store(next, std::memory_order_release);
+    }
+
     inline float getSamplePhase(double phase, Interpolations interpolation_mode) {
         double index = phase * getSampleCount();
         return getSampleIndex(index, interpolation_mode);
     }
 
+    // Any index is safe. It is clamped into the clip and the guards cover the kernels.
     inline float getSampleIndex(double index, Interpolations interpolation_mode) {
+        if (sample_count_ == 0)
+            return 0;
+
+        index = std::min(std::max(index, 0.0), sample_count_ - 1.0);
         switch (interpolation_mode) {
         case NONE:
-            return left_channel_[floor(index)];
+            return data()[(int)index];
             break;
         case LINEAR:
-            return interpolateLinearD(left_channel_.data(), index);
+            return interpolateLinearD(data(), index);
             break;
         case HERMITE:
-            return InterpolateHermite(left_channel_.data(), index, left_channel_.size());
+            return InterpolateHermite(data(), index);
             break;
         case BSPLINE:
-            return interpolateBSpline(left_channel_.data(), index);
+            return interpolateBSpline(data(), index);
             break;
         default:
-            return left_channel_[floor(index)];
+            return data()[(int)index];
         }
     }
 
+    // Slices published by the analysis worker. Double buffered, the reader
+    // always gets a complete table.
+    SliceTable &getSlices() {
+        return slice_tables_[slice_table_index_.load(std::memory_order_acquire)];
+    }
+
+    void publishSlices(const SliceTable &table) {
+        int next = 1 - slice_table_index_.load(std::memory_order_relaxed);
+        slice_tables_[next] = table;
+        slice_table_index_.store(next, std::memory_order_release);
+        analysis_version_++;
+    }
+
+    // Counts the slice and peak publishes, for caches of what is drawn from them.
+    uint32_t getAnalysisVersion() { return analysis_version_.load(std::memory_order_relaxed); }
+
+    // Peak pyramid for the display. Built by the analysis worker, double
+    // buffered like the slices.
+    PeakPyramid &getPeaks() {
+        return peak_pyramids_[peak_pyramid_index_.load(std::memory_order_acquire)];
+    }
+
+    void buildPeaks() {
+        int next = 1 - peak_pyramid_index_.load(std::memory_order_relaxed);
+        peak_pyramids_[next].build(data(), sample_count_);
+        peak_pyramid_index_.store(next, std::memory_order_release);
+        analysis_version_++;
+    }
+
+    // Level statistics published by the analysis worker.
+    void publishLoudness(const Loudness &loudness) {
+        peak_.store(loudness.peak, std::memory_order_relaxed);
+        rms_.store(loudness.rms, std::memory_order_relaxed);
+        lufs_.store(loudness.lufs, std::memory_order_relaxed);
+    }
+
+    float getPeak() { return peak_.load(std::memory_order_relaxed); }
+
+    float getRms() { return rms_.load(std::memory_order_relaxed); }
+
+    float getLufs() { return lufs_.load(std::memory_order_relaxed); }
+
+    // Tempo and fundamental published by the analysis worker. 0 when unknown.
+    void publishMetadata(float bpm, float pitch) {
+        bpm_.store(bpm, std::memory_order_relaxed);
+        pitch_.store(pitch, std::memory_order_relaxed);
+    }
+
+    float getBpm() { return bpm_.load(std::memory_order_relaxed); }
+
+    float getPitch() { return pitch_.load(std::memory_order_relaxed); }
+
+    // First audible sample, published by the analysis worker. Lines up attacks when morphing.
+    void publishAttackOffset(uint32_t offset) {
+        attack_offset_.store(offset, std::memory_order_relaxed);
+    }
+
+    // Phase over [attack offset, end) to a sample index.
+    inline double getAlignedIndex(double phase) {
+        const uint32_t offset = std::min(attack_offset_.load(std::memory_order_relaxed), getSampleCount());
+        return offset + phase * (getSampleCount() - offset);
+    }
+
+    // Two clips at the same aligned phase, crossfaded by mix. Both reads share
+    // one float_4 Hermite kernel. The guards cover the kernel at the ends.
+    static float getMorphSample(AudioClip &a, AudioClip &b, double phase, float mix) {
+        const double index_a = std::min(std::max(a.getAlignedIndex(phase), 0.0), a.getSampleCount() - 1.0);
+        const double index_b = std::min(std::max(b.getAlignedIndex(phase), 0.0), b.getSampleCount() - 1.0);
+        const int ia = index_a;
+        const int ib = index_b;
+        const float *pa = a.data() + ia - 1;
+        const float *pb = b.data() + ib - 1;
+
+        simd::float_4 x0(pa[0], pb[0], 0, 0);
+        simd::float_4 x1(pa[1], pb[1], 0, 0);
+        simd::float_4 x2(pa[2], pb[2], 0, 0);
+        simd::float_4 x3(pa[3], pb[3], 0, 0);
+        simd::float_4 t(index_a - ia, index_b - ib, 0, 0);
+        simd::float_4 y = Hermite4pt3oX(x0, x1, x2, x3, t);
+        return crossfade(y[0], y[1], mix);
+    }
+
+    // Guards and waveform. Call after the data changes. The search tables
+    // are left to the analysis worker.
+    void calculateAnalysis() {
+        updateGuards();
+        calculateWaveform();
+    }
+
     void calculateWaveform() {
         int pos = 0;
-        int samplesPerSlice = floorf(left_channel_.size() / WAVEFORM_RESOLUTION);
+        const float *samples = data();
+        int samplesPerSlice = floorf(sample_count_ / WAVEFORM_RESOLUTION);
+        if (samplesPerSlice == 0) {
+            std::fill(waveform_, waveform_ + WAVEFORM_RESOLUTION, 0.0f);
+            return;
+        }
+
         float max = 0;
         for (int i = 0; i < WAVEFORM_RESOLUTION; i++) {
             float acumulator = 0;
             for (int s = 0; s < samplesPerSlice; s++) {
-                acumulator += abs(left_channel_[pos]);
+                acumulator += abs(samples[pos]);
                 pos++;
             }
             waveform_[i] = acumulator / samplesPerSlice;
@@ -65,10 +228,23 @@ struct AudioClip
         }
     }
 
-    void startRec(unsigned int sampleRate)
+    // Not on the audio path. Room for the longest recording of channels.
+    void allocateRec(int channels)
+    {
+        rec_channels_ = clamp(channels, 1, MAX_CHANNELS);
+        stride_ = GUARD + maxRecordSamples + GUARD;
+        planes_.assign(rec_channels_ * stride_, 0.0f);
+    }
+
+    // Only resets counters, the planes come from allocateRec(). rec() only
+    // writes. Channels beyond the allocated ones are dropped.
+    void startRec(unsigned int sampleRate, int channels = 1)
     {
         sampleRate_ = sampleRate;
-        left_channel_.clear();
+        channels_ = clamp(channels, 1, rec_channels_);
+        sample_count_ = 0;
+        staged_ = 0;
+        path_.clear();
         counter_ = 0;
         acumulator_ = 0;
         waveform_index_ = 0;
@@ -76,13 +252,30 @@ struct AudioClip
             waveform_[i] = 0;
     }
 
+    // One frame of channels_ values, scaled by gain. The frame must be readable
+    // in whole float_4s. Frames are staged four at a time, then transposed so
+    // every channel plane gets one float_4 store.
     // Returns true while recording. Until max recording time.
-    bool rec(float sample) {
-        // Save data
-        left_channel_.push_back(clamp(sample, -1.0f, 1.0f));
+    bool rec(const float *frame, float gain = 1.0f) {
+        const int groups = (channels_ + 3) / 4;
+        for (int g = 0; g < groups; g++)
+            staging_[g][staged_] = simd::clamp(simd::float_4::load(frame + g * 4) * gain, -1.0f, 1.0f);
+        const float sample = staging_[0][staged_][0];
+        sample_count_++;
+
+        if (++staged_ == 4) {
+            const int index = sample_count_ - 4;
+            for (int g = 0; g < groups; g++) {
+                simd::float_4 *block = staging_[g];
+                _MM_TRANSPOSE4_PS(block[0].v, block[1].v, block[2].v, block[3].v);
+                for (int c = 0; c < 4 && g * 4 + c < (int)channels_; c++)
+                    block[c].store(data(g * 4 + c) + index);
+            }
+            staged_ = 0;
+        }
 
         // Online waveform
-        if (left_channel_.size() > WAVEFORM_RESOLUTION) {
+        if (sample_count_ > WAVEFORM_RESOLUTION) {
             counter_++;
             acumulator_ += abs(sample);
             int samplesPerSlice = floorf(maxRecordSamples / WAVEFORM_RESOLUTION);
@@ -94,15 +287,33 @@ struct AudioClip
             }
         }
 
-        // Stop recording
-        if (left_channel_.size() >= maxRecordSamples) {
-            calculateWaveform();
+        // Max recording time. The caller stops the recording.
+        if (sample_count_ >= maxRecordSamples)
             return false;
-        }
 
         return true;
     }
 
+    bool rec(float sample) {
+        const float frame[4] = { sample, 0, 0, 0 };
+        return rec(frame);
+    }
+
+    // Writes the frames still staged. Safe on the audio thread. The clip keeps
+    // its recording space until the analysis worker swaps in a compact copy.
+    void stopRec() {
+        const int index = sample_count_ - staged_;
+        for (int i = 0; i < staged_; i++)
+            for (int c = 0; c < (int)channels_; c++)
+                data(c)[index + i] = staging_[c / 4][i][c % 4];
+        staged_ = 0;
+    }
+
+    // True for recordings, whose planes still hold the unused recording space.
+    bool hasRecordSpace() {
+        return planes_.size() > channels_ * (size_t)(GUARD + sample_count_ + GUARD);
+    }
+
     void load(const std::string &path) {
         drwav_uint64 totalSampleCount = 0;
 
@@ -110,67 +321,143 @@ struct AudioClip
 
         if (pSampleData == NULL)
             return;
-        
-        left_channel_.clear();
 
-        for (size_t i = 0; i < totalSampleCount; i += channels_)
-            left_channel_.push_back(pSampleData[i]);
+        // Files beyond MAX_CHANNELS keep the first ones.
+        const int file_channels = channels_;
+        channels_ = clamp((int)channels_, 1, MAX_CHANNELS);
+        sample_count_ = totalSampleCount / file_channels;
+        stride_ = GUARD + sample_count_ + GUARD;
+        planes_.assign(channels_ * stride_, 0.0f);
+
+        for (size_t i = 0; i < sample_count_; i++)
+            for (int c = 0; c < (int)channels_; c++)
+                data(c)[i] = pSampleData[i * file_channels + c];
 
         drwav_free(pSampleData);
+        path_ = path;
 
-        calculateWaveform();
+        calculateAnalysis();
     }
 
     void saveToDisk(std::string path) {
-        int samples = left_channel_.size();
+        int samples = sample_count_;
 
-        float data[samples];
+        std::vector<float> interleaved(samples * channels_);
 
         for (int i = 0; i < samples; i++)
-            data[i] = left_channel_[i];
+            for (int c = 0; c < (int)channels_; c++)
+                interleaved[i * channels_ + c] = data(c)[i];
 
         drwav_data_format format;
 
         format.container = drwav_container_riff;   // <-- drwav_container_riff = normal WAV files, drwav_container_w64 = Sony Wave64.
         format.format = DR_WAVE_FORMAT_IEEE_FLOAT; // <-- Any of the DR_WAVE_FORMAT_* codes.
-        format.channels = 1;
+        format.channels = channels_;
         format.sampleRate = sampleRate_;
         format.bitsPerSample = 32;
         drwav *pWav = drwav_open_file_write(path.c_str(), &format);
 
-        drwav_write(pWav, samples, data);
+        drwav_write(pWav, interleaved.size(), interleaved.data());
 
         drwav_close(pWav);
     }
 
-    void trim(double start, double end) {
-        int samples_before = getSampleCount();
+    // This clip becomes [start, end) of source. Source is only read.
+    void trim(AudioClip &source, double start, double end) {
+        sampleRate_ = source.sampleRate_;
+        channels_ = source.channels_;
+        name_ = source.name_;
+        root_note_ = source.root_note_;
+
+        int samples_before = source.getSampleCount();
         int samples_to_copy = (end - start) * samples_before;
 
         int remove_l = start * samples_before;
+        samples_to_copy = std::min(samples_to_copy, samples_before - remove_l);
 
-        std::vector<float> left_channel_copy;
+        const int channels = channels_;
+        const int stride = GUARD + samples_to_copy + GUARD;
+        std::vector<float> planes(channels * stride, 0.0f);
+        for (int c = 0; c < channels; c++)
+            std::copy(source.data(c) + remove_l, source.data(c) + remove_l + samples_to_copy, planes.data() + c * stride + GUARD);
 
-        for (int i = remove_l; i < samples_to_copy; i++)
-            left_channel_copy.push_back(left_channel_[i]);
+        planes_.swap(planes);
+        stride_ = stride;
+        sample_count_ = samples_to_copy;
+        path_.clear();
 
-        left_channel_.clear();
+        calculateAnalysis();
+    }
 
-        for (int i = 0; i < samples_to_copy; i++)
-            left_channel_.push_back(left_channel_copy[i]);
+private:
 
-        calculateWaveform();
+    static uint32_t nextGeneration() {
+        static std::atomic<uint32_t> generation{0};
+        return ++generation;
     }
 
-private:
+    // ClipSlots retirement list.
+    template <int SLOTS> friend struct ClipSlots;
+    AudioClip *retired_next_ = nullptr;
+    uint64_t retired_epoch_ = 0;
+
+    // Drop unused recording space, then repeat the edge samples into the guards.
+    void updateGuards() {
+        const int channels = channels_;
+        const int stride = GUARD + sample_count_ + GUARD;
+        if (stride_ != stride) {
+            std::vector<float> planes(channels * stride, 0.0f);
+            for (int c = 0; c < channels; c++)
+                std::copy(data(c), data(c) + sample_count_, planes.data() + c * stride + GUARD);
+            planes_.swap(planes);
+            stride_ = stride;
+        }
 
-    std::vector<float> left_channel_;
-    unsigned int channels_ = 0;
+        for (int c = 0; c < channels; c++) {
+            float *samples = data(c);
+            const float first = sample_count_ > 0 ? samples[0] : 0.0f;
+            const float last = sample_count_ > 0 ? samples[sample_count_ - 1] : 0.0f;
+            for (int i = 1; i <= GUARD; i++) {
+                samples[-i] = first;
+                samples[sample_count_ - 1 + i] = last;
+            }
+        }
+    }
+
+    // Planes of stride_ samples: GUARD, the channel, GUARD and any recording space.
+    std::vector<float> planes_;
+    int stride_ = 2 * GUARD;
+    unsigned int sample_count_ = 0;
+    std::vector<float> decimated_[2];
+    std::atomic<int> decimated_index_{0};
+    ZeroCrossings zero_crossings_[2];
+    std::atomic<int> zero_crossings_index_{0};
+    SliceTable slice_tables_[2];
+    std::atomic<int> slice_table_index_{0};
+    PeakPyramid peak_pyramids_[2];
+    std::atomic<int> peak_pyramid_index_{0};
+    std::atomic<uint32_t> analysis_version_{0};
+    std::atomic<float> peak_{0.0f};
+    std::atomic<float> rms_{0.0f};
+    std::atomic<float> lufs_{-70.0f};
+    std::atomic<uint32_t> attack_offset_{0};
+    std::atomic<float> bpm_{0.0f};
+    std::atomic<float> pitch_{0.0f};
+    std::string path_;
+    std::string name_;
+    int root_note_ = -1;
+    const uint32_t generation_ = nextGeneration();
+    unsigned int channels_ = 1;
     unsigned int sampleRate_ = 0;
 
     const unsigned int maxRecordSamples = 44100 * 10;
+    int rec_channels_ = 0;
     float waveform_[WAVEFORM_RESOLUTION] = {0, 0, 0, 0};
 
+    // Frames waiting for a transposed store, per group of four channels.
+    simd::float_4 staging_[MAX_CHANNELS / 4][4];
+    int staged_ = 0;
+
     // Used for waveform while recording
     int waveform_index_ = 0;
     int counter_ = 0;
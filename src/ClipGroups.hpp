@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+
+// Round robin sets and velocity layers from file names. Clips whose names only
+// differ by "rrN" or "vN" tokens form a group, like "Snare_v1_rr2". Built on
+// folder load into a spare copy, never the one being read. Picking a member
+// at trigger time is index arithmetic only.
+struct ClipGroups
+{
+    static const int MAX_CLIPS = 256;
+
+    void build(const std::vector<std::string> &names)
+    {
+        count_ = std::min((int)names.size(), (int)MAX_CLIPS);
+
+        std::vector<Entry> entries;
+        for (int i = 0; i < count_; i++)
+            entries.push_back(parseName(names[i], i));
+        std::sort(entries.begin(), entries.end());
+
+        int groups = 0;
+        int layers = 0;
+        for (int i = 0; i < count_; i++) {
+            const Entry &entry = entries[i];
+            const bool new_group = i == 0 || entry.key != entries[i - 1].key;
+            const bool new_layer = new_group || entry.layer != entries[i - 1].layer;
+
+            if (new_group) {
+                layer_start_[groups] = layers;
+                layer_count_[groups] = 0;
+                groups++;
+            }
+
+            if (new_layer) {
+                member_start_[layers] = i;
+                member_count_[layers] = 0;
+                round_robin_[layers] = 0;
+                layer_count_[groups - 1]++;
+                layers++;
+            }
+
+            members_[i] = entry.index;
+            member_count_[layers - 1]++;
+            group_[entry.index] = groups - 1;
+        }
+    }
+
+    // Clips added after the build, like recordings, are groups of their own.
+    int getGroup(int clip)
+    {
+        return clip < count_ ? group_[clip] : -1 - clip;
+    }
+
+    // Layer from velocity in [0, 1], then the layer's next round robin member.
+    int select(int clip, float velocity)
+    {
+        if (clip < 0 || clip >= count_)
+            return clip;
+
+        const int group = group_[clip];
+        const int layer = layer_start_[group] + std::min((int)(velocity * layer_count_[group]), layer_count_[group] - 1);
+        const int member = round_robin_[layer]++ % member_count_[layer];
+        return members_[member_start_[layer] + member];
+    }
+
+private:
+
+    struct Entry {
+        std::string key;
+        int layer;
+        int round_robin;
+        int index;
+
+        bool operator<(const Entry &other) const
+        {
+            if (key != other.key)
+                return key < other.key;
+            if (layer != other.layer)
+                return layer < other.layer;
+            if (round_robin != other.round_robin)
+                return round_robin < other.round_robin;
+            return index < other.index;
+        }
+    };
+
+    int count_ = 0;
+    int group_[MAX_CLIPS];
+    int layer_start_[MAX_CLIPS];
+    int layer_count_[MAX_CLIPS];
+    int member_start_[MAX_CLIPS];
+    int member_count_[MAX_CLIPS];
+    int members_[MAX_CLIPS];
+    unsigned int round_robin_[MAX_CLIPS];
+
+    // Splits on '_', '-' and ' '. Numbered "rr" and "v" tokens leave the key.
+    static Entry parseName(const std::string &name, int index)
+    {
+        Entry entry = {"", 0, 0, index};
+        size_t begin = 0;
+        while (begin <= name.size()) {
+            size_t end = name.find_first_of("_- ", begin);
+            if (end == std::string::npos)
+                end = name.size();
+
+            std::string token = name.substr(begin, end - begin);
+            std::transform(token.begin(), token.end(), token.begin(), ::tolower);
+
+            if (isNumbered(token, "rr"))
+                entry.round_robin = std::stoi(token.substr(2));
+            else if (isNumbered(token, "v"))
+                entry.layer = std::stoi(token.substr(1));
+            else
+                entry.key += token + "_";
+
+            begin = end + 1;
+        }
+        return entry;
+    }
+
+    static bool isNumbered(const std::string &token, const std::string &prefix)
+    {
+        if (token.size() <= prefix.size() || token.size() > prefix.size() + 3 || token.compare(0, prefix.size(), prefix) != 0)
+            return false;
+
+        for (size_t i = prefix.size(); i < token.size(); i++)
+            if (!isdigit(token[i]))
+                return false;
+        return true;
+    }
+};
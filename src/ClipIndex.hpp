@@ -0,0 +1,125 @@
+#include <map>
+#include <sys/stat.h>
+
+// Per folder cache of the slow clip analysis, stored next to the clips so it
+// runs once per file. Entries are keyed by file name and dropped when the
+// file size or modification time change. Worker thread only.
+struct ClipIndex
+{
+    struct Entry {
+        int64_t size;
+        int64_t modified;
+        float bpm;
+        float pitch;
+    };
+
+    // False when the file is not indexed, or changed since.
+    bool lookup(const std::string &path, Entry &entry)
+    {
+        Entry current;
+        if (!readFileStats(path, current))
+            return false;
+
+        open(system::getDirectory(path));
+        std::map<std::string, Entry>::iterator it = entries_.find(system::getFilename(path));
+        if (it == entries_.end() || it->second.size != current.size || it->second.modified != current.modified)
+            return false;
+
+        entry = it->second;
+        return true;
+    }
+
+    // Kept in memory until flush(), so a folder pass writes the file once.
+    void store(const std::string &path, Entry entry)
+    {
+        if (!readFileStats(path, entry))
+            return;
+
+        open(system::getDirectory(path));
+        entries_[system::getFilename(path)] = entry;
+        dirty_ = true;
+    }
+
+    // Rewrites the folder's index file when entries were stored since the last flush.
+    void flush()
+    {
+        if (!dirty_)
+            return;
+
+        dirty_ = false;
+        save();
+    }
+
+private:
+
+    std::string directory_;
+    std::map<std::string, Entry> entries_;
+    bool dirty_ = false;
+
+    static std::string getIndexPath(const std::string &directory)
+    {
+        return directory + "/.advancedsampler_index.json";
+    }
+
+    static bool readFileStats(const std::string &path, Entry &entry)
+    {
+        struct stat info;
+        if (path.empty() || stat(path.c_str(), &info) != 0)
+            return false;
+
+        entry.size = info.st_size;
+        entry.modified = info.st_mtime;
+        return true;
+    }
+
+    void open(const std::string &directory)
+    {
+        if (directory == directory_)
+            return;
+
+        flush();
+        directory_ = directory;
+        entries_.clear();
+
+        json_t *rootJ = json_load_file(getIndexPath(directory).c_str(), 0, NULL);
+        if (!rootJ)
+            return;
+
+        size_t index;
+        json_t *clipJ;
+        json_array_foreach(json_object_get(rootJ, "clips"), index, clipJ) {
+            json_t *fileJ = json_object_get(clipJ, "file");
+            if (!json_is_string(fileJ))
+                continue;
+
+            Entry entry;
+            entry.size = json_integer_value(json_object_get(clipJ, "size"));
+            entry.modified = json_integer_value(json_object_get(clipJ, "modified"));
+            entry.bpm = json_number_value(json_object_get(clipJ, "bpm"));
+            entry.pitch = json_number_value(json_object_get(clipJ, "pitch"));
+            entries_[json_string_value(fileJ)] = entry;
+        }
+
+        json_decref(rootJ);
+    }
+
+    void save()
+    {
+        json_t *clipsJ = json_array();
+        for (std::map<std::string, Entry>::iterator it = entries_.begin(); it != entries_.end(); ++it) {
+            json_t *clipJ = json_object();
+            json_object_set_new(clipJ, "file", json_string(it->first.c_str()));
+            json_object_set_new(clipJ, "size", json_integer(it->second.size));
+            json_object_set_new(clipJ, "modified", json_integer(it->second.modified));
+            json_object_set_new(clipJ, "bpm", json_real(it->second.bpm));
+            json_object_set_new(clipJ, "pitch", json_real(it->second.pitch));
+            json_array_append_new(clipsJ, clipJ);
+        }
+
+        json_t *rootJ = json_object();
+        json_object_set_new(rootJ, "version", json_integer(1));
+        json_object_set_new(rootJ, "clips", clipsJ);
+        json_dump_file(rootJ, getIndexPath(directory_).c_str(), JSON_INDENT(2));
+        json_decref(rootJ);
+    }
+};
@@ -0,0 +1,108 @@
+#include <atomic>
+#include <cstdint>
+
+// Clips shared by the audio thread, the display and the workers. Each slot
+// points at a clip that is not resized once published. publish() swaps the
+// pointer and retires the old clip. collect() deletes it once no reader can
+// still hold it: every reader announces the epoch it started reading in, and
+// a clip retired in epoch E is free when all announced epochs are past E.
+template <int SLOTS>
+struct ClipSlots
+{
+    // The display needs no guard, collect() runs on its thread.
+    enum Readers {
+        AUDIO_READER,
+        ANALYSIS_READER,
+        WAVETABLE_READER,
+        NUM_READERS
+    };
+
+    // Clips fetched while the guard lives stay valid until it ends.
+    struct ReadGuard {
+        ReadGuard(ClipSlots &slots, Readers reader) : slots_(slots), reader_(reader) {
+            slots_.active_[reader_].store(slots_.epoch_.load());
+        }
+
+        ~ReadGuard() {
+            slots_.active_[reader_].store(IDLE);
+        }
+
+        ClipSlots &slots_;
+        Readers reader_;
+    };
+
+    ClipSlots() {
+        for (int i = 0; i < SLOTS; i++)
+            slots_[i].store(new AudioClip());
+        for (int r = 0; r < NUM_READERS; r++)
+            active_[r].store(IDLE);
+    }
+
+    // Readers are gone by now.
+    ~ClipSlots() {
+        for (int i = 0; i < SLOTS; i++)
+            delete slots_[i].load();
+        deleteRetired(retired_.exchange(nullptr), IDLE);
+    }
+
+    AudioClip &get(int index) {
+        return *slots_[index].load(std::memory_order_acquire);
+    }
+
+    // Any thread, never blocks. The clip must not be resized after this.
+    void publish(int index, AudioClip *clip) {
+        retire(slots_[index].exchange(clip));
+    }
+
+    // Like publish(), but only while the slot still holds expected. False
+    // and nothing published otherwise.
+    bool replace(int index, AudioClip *expected, AudioClip *clip) {
+        if (!slots_[index].compare_exchange_strong(expected, clip))
+            return false;
+
+        retire(expected);
+        return true;
+    }
+
+    // Deletes what no reader can hold. The display thread only.
+    void collect() {
+        AudioClip *retired = retired_.exchange(nullptr);
+        if (!retired)
+            return;
+
+        uint64_t oldest = IDLE;
+        for (int r = 0; r < NUM_READERS; r++)
+            oldest = std::min(oldest, active_[r].load());
+        deleteRetired(retired, oldest);
+    }
+
+private:
+    static const uint64_t IDLE = UINT64_MAX;
+
+    void retire(AudioClip *old) {
+        old->retired_epoch_ = epoch_.fetch_add(1);
+
+        old->retired_next_ = retired_.load();
+        while (!retired_.compare_exchange_weak(old->retired_next_, old)) {}
+    }
+
+    // Deletes the clips retired before the oldest epoch, keeps the rest.
+    void deleteRetired(AudioClip *clip, uint64_t oldest) {
+        while (clip) {
+            AudioClip *next = clip->retired_next_;
+            if (clip->retired_epoch_ < oldest) {
+                delete clip;
+            }
+            else {
+                clip->retired_next_ = retired_.load();
+                while (!retired_.compare_exchange_weak(clip->retired_next_, clip)) {}
+            }
+            clip = next;
+        }
+    }
+
+    std::atomic<AudioClip*> slots_[SLOTS];
+    std::atomic<AudioClip*> retired_{nullptr};
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<uint64_t> active_[NUM_READERS];
+};
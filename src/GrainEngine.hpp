@@ -0,0 +1,116 @@
+// Grain window Look up table. Hann window.
+static const float grain_window_hann[257] = {0.000000f,0.000151f,0.000602f,0.001355f,0.002408f,0.003760f,0.005412f,0.007361f,0.009607f,0.012149f,0.014984f,0.018112f,0.021530f,0.025236f,0.029228f,0.033504f,0.038060f,0.042895f,0.048005f,0.053388f,0.059039f,0.064957f,0.071136f,0.077573f,0.084265f,0.091208f,0.098396f,0.105827f,0.113495f,0.121396f,0.129524f,0.137876f,0.146447f,0.155230f,0.164221f,0.173414f,0.182803f,0.192384f,0.202150f,0.212096f,0.222215f,0.232501f,0.242949f,0.253551f,0.264302f,0.275194f,0.286222f,0.297379f,0.308658f,0.320052f,0.331555f,0.343159f,0.354858f,0.366644f,0.378510f,0.390449f,0.402455f,0.414519f,0.426635f,0.438795f,0.450991f,0.463218f,0.475466f,0.487729f,0.500000f,0.512271f,0.524534f,0.536782f,0.549009f,0.561205f,0.573365f,0.585481f,0.597545f,0.609551f,0.621490f,0.633356f,0.645142f,0.656841f,0.668445f,0.679948f,0.691342f,0.702621f,0.713778f,0.724806f,0.735698f,0.746449f,0.757051f,0.767499f,0.777785f,0.787904f,0.797850f,0.807616f,0.817197f,0.826586f,0.835779f,0.844770f,0.853553f,0.862124f,0.870476f,0.878604f,0.886505f,0.894173f,0.901604f,0.908792f,0.915735f,0.922427f,0.928864f,0.935043f,0.940961f,0.946612f,0.951995f,0.957105f,0.961940f,0.966496f,0.970772f,0.974764f,0.978470f,0.981888f,0.985016f,0.987851f,0.990393f,0.992639f,0.994588f,0.996240f,0.997592f,0.998645f,0.999398f,0.999849f,1.000000f,0.999849f,0.999398f,0.998645f,0.997592f,0.996240f,0.994588f,0.992639f,0.990393f,0.987851f,0.985016f,0.981888f,0.978470f,0.974764f,0.970772f,0.966496f,0.961940f,0.957105f,0.951995f,0.946612f,0.940961f,0.935043f,0.928864f,0.922427f,0.915735f,0.908792f,0.901604f,0.894173f,0.886505f,0.878604f,0.870476f,0.862124f,0.853553f,0.844770f,0.835779f,0.826586f,0.817197f,0.807616f,0.797850f,0.787904f,0.777785f,0.767499f,0.757051f,0.746449f,0.735698f,0.724806f,0.713778f,0.702621f,0.691342f,0.679948f,0.668445f,0.656841f,0.645142f,0.633356f,0.621490f,0.609551f,0.597545f,0.585481f,0.573365f,0.561205f,0.549009f,0.536782f,0.524534f,0.512271f,0.500000f,0.487729f,0.475466f,0.463218f,0.450991f,0.438795f,0.426635f,0.414519f,0.402455f,0.390449f,0.378510f,0.366644f,0.354858f,0.343159f,0.331555f,0.320052f,0.308658f,0.297379f,0.286222f,0.275194f,0.264302f,0.253551f,0.242949f,0.232501f,0.222215f,0.212096f,0.202150f,0.192384f,0.182803f,0.173414f,0.164221f,0.155230f,0.146447f,0.137876f,0.129524f,0.121396f,0.113495f,0.105827f,0.098396f,0.091208f,0.084265f,0.077573f,0.071136f,0.064957f,0.059039f,0.053388f,0.048005f,0.042895f,0.038060f,0.033504f,0.029228f,0.025236f,0.021530f,0.018112f,0.014984f,0.012149f,0.009607f,0.007361f,0.005412f,0.003760f,0.002408f,0.001355f,0.000602f,0.000151f,0.000000f};
+
+// Granular playback on top of an AudioClip. Fixed grain pool, no allocations.
+struct GrainEngine
+{
+    static const int MAX_GRAINS = 64;
+
+    // Scheduling parameters. Set at control rate.
+    float density_ = 20.0f;  // Grains per second.
+    float size_ = 0.1f;      // Grain length in seconds.
+    float position_ = 0.0f;  // Normalized clip position.
+    float spray_ = 0.0f;     // Random position offset relative to grain size.
+    float pitch_ = 1.0f;     // Playback rate relative to the clip sample rate.
+
+    // Same seed, same cloud.
+    void reset(uint32_t seed = 0x9E3779B9) {
+        active_count_ = 0;
+        countdown_ = 0;
+        random_state_ = seed;
+    }
+
+    float process(AudioClip &clip, Interpolations interpolation_mode, float sample_time) {
+        const int count = clip.getSampleCount();
+        if (count < 4)
+            return 0;
+
+        // Schedule.
+        countdown_ -= 1.0f;
+        if (countdown_ <= 0) {
+            spawn(clip, sample_time);
+            countdown_ += 1.0f / (density_ * sample_time);
+        }
+
+        // Read. Keep the 4 point kernels inside the clip.
+        const double min_index = 1;
+        const double max_index = count - 3;
+        const int n = active_count_;
+        for (int i = 0; i < n; i++) {
+            samples_[i] = clip.getSampleIndex(std::min(std::max(read_index_[i], min_index), max_index), interpolation_mode);
+            windows_[i] = interpolateLinear(grain_window_hann, window_phase_[i] * 256) * gain_;
+            read_index_[i] += increment_[i];
+            window_phase_[i] += window_increment_[i];
+        }
+
+        // Pad the last vector.
+        for (int i = n; i < ((n + 3) & ~3); i++) {
+            samples_[i] = 0;
+            windows_[i] = 0;
+        }
+
+        // Sum.
+        simd::float_4 sum = 0;
+        for (int i = 0; i < n; i += 4)
+            sum += simd::float_4::load(&samples_[i]) * simd::float_4::load(&windows_[i]);
+
+        // Retire finished grains.
+        for (int i = n - 1; i >= 0; i--)
+            if (window_phase_[i] >= 1.0f)
+                remove(i);
+
+        return sum[0] + sum[1] + sum[2] + sum[3];
+    }
+
+    int getActiveCount() {
+        return active_count_;
+    }
+
+private:
+
+    // Active grains are packed at the start of the arrays.
+    double read_index_[MAX_GRAINS];
+    double increment_[MAX_GRAINS];
+    float window_phase_[MAX_GRAINS];
+    float window_increment_[MAX_GRAINS];
+    float samples_[MAX_GRAINS];
+    float windows_[MAX_GRAINS];
+
+    int active_count_ = 0;
+    float countdown_ = 0;
+    float gain_ = 1;
+    uint32_t random_state_ = 0x9E3779B9;
+
+    void spawn(AudioClip &clip, float sample_time) {
+        if (active_count_ >= MAX_GRAINS)
+            return;
+
+        float offset = (randomUniform() * 2.0f - 1.0f) * spray_ * size_ / clip.getSeconds();
+        float position = clamp(position_ + offset, 0.0f, 1.0f);
+
+        int i = active_count_++;
+        read_index_[i] = position * (clip.getSampleCount() - 1);
+        increment_[i] = pitch_ * clip.getSampleRate() * sample_time;
+        window_phase_[i] = 0;
+        window_increment_[i] = sample_time / size_;
+
+        // Keep overlapping grains at a constant level.
+        gain_ = 1.0f / std::sqrt(std::max(1.0f, density_ * size_));
+    }
+
+    void remove(int i) {
+        active_count_--;
+        read_index_[i] = read_index_[active_count_];
+        increment_[i] = increment_[active_count_];
+        window_phase_[i] = window_phase_[active_count_];
+        window_increment_[i] = window_increment_[active_count_];
+    }
+
+    // xorshift32
+    float randomUniform() {
+        random_state_ ^= random_state_ << 13;
+        random_state_ ^= random_state_ >> 17;
+        random_state_ ^= random_state_ << 5;
+        return (random_state_ >> 8) * (1.0f / 16777216.0f);
+    }
+};
@@ -0,0 +1,122 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// Maps MIDI notes to clips. Each clip with a root note owns the notes closest
+// to its root, so picking the clip and its transposition is one table read.
+struct KeyMap
+{
+    static const int NUM_NOTES = 128;
+    static const int NO_ROOT = -1;
+
+    // root_notes[i] is the MIDI root of clip i, or NO_ROOT.
+    void build(const int *root_notes, int count)
+    {
+        mapped_ = false;
+        for (int note = 0; note < NUM_NOTES; note++) {
+            int best = NO_ROOT;
+            int best_distance = NUM_NOTES;
+            for (int i = 0; i < count; i++) {
+                if (root_notes[i] == NO_ROOT)
+                    continue;
+                const int distance = std::abs(note - root_notes[i]);
+                if (distance < best_distance) {
+                    best = i;
+                    best_distance = distance;
+                }
+            }
+
+            clip_[note] = best;
+            root_[note] = best == NO_ROOT ? note : root_notes[best];
+            mapped_ |= best != NO_ROOT;
+        }
+    }
+
+    bool isMapped() { return mapped_; }
+
+    // Clip index for a note, NO_ROOT when the map is empty.
+    int getClip(int note) { return clip_[clamp(note, 0, NUM_NOTES - 1)]; }
+
+    // Root note of the clip playing a note.
+    int getRoot(int note) { return root_[clamp(note, 0, NUM_NOTES - 1)]; }
+
+    // Last note name in a file name, like "Piano_F#3" or "Bass Bb1". C4 is 60.
+    static int parseNoteName(const std::string &name)
+    {
+        static const int pitch_classes[7] = {9, 11, 0, 2, 4, 5, 7};  // A to G.
+        int root = NO_ROOT;
+        const int length = name.size();
+        for (int i = 0; i < length; i++) {
+            const char letter = toupper(name[i]);
+            if (letter < 'A' || letter > 'G' || (i > 0 && isalpha(name[i - 1])))
+                continue;
+
+            int j = i + 1;
+            int note = pitch_classes[letter - 'A'];
+            if (j < length && name[j] == '#') {
+                note++;
+                j++;
+            }
+            else if (j < length && name[j] == 'b') {
+                note--;
+                j++;
+            }
+
+            int octave_sign = 1;
+            if (j < length && name[j] == '-') {
+                octave_sign = -1;
+                j++;
+            }
+
+            if (j >= length || !isdigit(name[j]) || (j + 1 < length && isalnum(name[j + 1])))
+                continue;
+
+            note += (octave_sign * (name[j] - '0') + 1) * 12;
+            if (note >= 0 && note < NUM_NOTES)
+                root = note;
+        }
+        return root;
+    }
+
+    // MIDI unity note from the smpl chunk of a WAV file. dr_wav skips it.
+    static int readSmplRootNote(const std::string &path)
+    {
+        FILE *file = fopen(path.c_str(), "rb");
+        if (file == NULL)
+            return NO_ROOT;
+
+        int root = NO_ROOT;
+        uint8_t header[12];
+        if (fread(header, 1, 12, file) == 12 && memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WAVE", 4) == 0) {
+            uint8_t chunk[8];
+            while (fread(chunk, 1, 8, file) == 8) {
+                const uint32_t size = readLittleEndian(chunk + 4);
+                if (memcmp(chunk, "smpl", 4) == 0) {
+                    // Manufacturer, product, sample period, unity note.
+                    uint8_t data[16];
+                    if (size >= 16 && fread(data, 1, 16, file) == 16 && readLittleEndian(data + 12) < NUM_NOTES)
+                        root = readLittleEndian(data + 12);
+                    break;
+                }
+
+                // Chunks are word aligned.
+                if (fseek(file, size + (size & 1), SEEK_CUR) != 0)
+                    break;
+            }
+        }
+
+        fclose(file);
+        return root;
+    }
+
+private:
+
+    int16_t clip_[NUM_NOTES];
+    uint8_t root_[NUM_NOTES];
+    bool mapped_ = false;
+
+    static uint32_t readLittleEndian(const uint8_t *bytes)
+    {
+        return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+    }
+};
@@ -0,0 +1,169 @@
+// Live looper. The first pass sets the loop length, overdubs mix the input
+// over the loop with feedback. The buffer is allocated up front, the audio
+// thread never allocates.
+struct Looper
+{
+    static const int MAX_SECONDS = 20;
+    static const int FADE_SAMPLES = 64;  // Punch ramp. Starts at the trigger sample.
+
+    enum States {
+        EMPTY,
+        RECORDING,   // First pass.
+        PLAYING,
+        OVERDUBBING,
+    };
+
+    float feedback_ = 1.0f;  // Loop level kept under an overdub. Set at control rate.
+
+    Looper() {
+        clear();
+    }
+
+    // Not on the audio path. Drops the loop.
+    void allocate(float sample_rate) {
+        buffer_.assign((size_t)(MAX_SECONDS * sample_rate), 0.0f);
+        clear();
+    }
+
+    void clear() {
+        state_.store(EMPTY, std::memory_order_relaxed);
+        length_ = 0;
+        position_ = 0;
+        punch_ = 0;
+        bin_ = 0;
+        bin_peak_ = 0;
+        phase_.store(0, std::memory_order_relaxed);
+        std::fill(working_, working_ + WAVEFORM_RESOLUTION, 0.0f);
+        publishWaveform();
+    }
+
+    // Safe from the UI thread. The audio thread clears on its next sample.
+    void requestClear() {
+        clear_requested_.store(true, std::memory_order_relaxed);
+    }
+
+    // REC press. Starts the first pass, closes the loop, then punches overdubs in and out.
+    void toggle() {
+        switch (getState()) {
+        case EMPTY:
+            if (!buffer_.empty()) {
+                clear();
+                state_.store(RECORDING, std::memory_order_relaxed);
+            }
+            break;
+        case RECORDING:
+            close();
+            break;
+        case PLAYING:
+            state_.store(OVERDUBBING, std::memory_order_relaxed);
+            break;
+        case OVERDUBBING:
+            state_.store(PLAYING, std::memory_order_relaxed);
+            break;
+        }
+    }
+
+    // One engine sample. Returns the loop before this sample's overdub.
+    float process(float input) {
+        if (clear_requested_.load(std::memory_order_relaxed)) {
+            clear_requested_.store(false, std::memory_order_relaxed);
+            clear();
+        }
+
+        const States state = getState();
+        if (state == EMPTY)
+            return 0;
+
+        input = clamp(input, -1.0f, 1.0f);
+
+        // First pass. Waveform bins span the whole buffer until the loop closes.
+        if (state == RECORDING) {
+            buffer_[length_] = input;
+            updateWaveform(input, (uint64_t)length_ * WAVEFORM_RESOLUTION / buffer_.size());
+            if (++length_ >= buffer_.size())
+                close();
+            return 0;
+        }
+
+        // Ramp the overdub in or out from this sample on.
+        const float target = state == OVERDUBBING ? 1.0f : 0.0f;
+        punch_ += clamp(target - punch_, -1.0f / FADE_SAMPLES, 1.0f / FADE_SAMPLES);
+
+        float &sample = buffer_[position_];
+        const float out = sample;
+        if (punch_ > 0.0f)
+            sample = clamp(sample * (1.0f - punch_ * (1.0f - feedback_)) + input * punch_, -1.0f, 1.0f);
+
+        // The playhead refreshes one waveform bin at a time.
+        updateWaveform(sample, (uint64_t)position_ * WAVEFORM_RESOLUTION / length_);
+        if (++position_ >= length_)
+            position_ = 0;
+        phase_.store((float)position_ / length_, std::memory_order_relaxed);
+
+        return out;
+    }
+
+    States getState() { return state_.load(std::memory_order_relaxed); }
+
+    bool isEmpty() { return getState() == EMPTY; }
+
+    // Playhead over the loop, for the display.
+    float getPhase() { return phase_.load(std::memory_order_relaxed); }
+
+    // Latest complete waveform snapshot. Display thread only, it stays intact
+    // until the next call. Triple buffered: the audio thread writes its own
+    // buffer and trades it for the shared one, never touching the reader's.
+    float *getWaveform() {
+        if (waveform_shared_.load(std::memory_order_relaxed) & FRESH)
+            waveform_front_ = waveform_shared_.exchange(waveform_front_, std::memory_order_acq_rel) & ~FRESH;
+        return waveforms_[waveform_front_];
+    }
+
+private:
+
+    // Play from the top. A first pass shorter than one bin is dropped.
+    void close() {
+        if (length_ < WAVEFORM_RESOLUTION) {
+            clear();
+            return;
+        }
+
+        position_ = 0;
+        bin_ = 0;
+        bin_peak_ = 0;
+        state_.store(PLAYING, std::memory_order_relaxed);
+    }
+
+    // Peak of each bin, published when the bin is left.
+    void updateWaveform(float sample, int bin) {
+        if (bin != bin_) {
+            working_[bin_] = bin_peak_ * 0.8f;
+            publishWaveform();
+            bin_ = bin;
+            bin_peak_ = 0;
+        }
+        bin_peak_ = std::max(bin_peak_, std::abs(sample));
+    }
+
+    void publishWaveform() {
+        std::copy(working_, working_ + WAVEFORM_RESOLUTION, waveforms_[waveform_back_]);
+        waveform_back_ = waveform_shared_.exchange(waveform_back_ | FRESH, std::memory_order_acq_rel) & ~FRESH;
+    }
+
+    std::vector<float> buffer_;
+    std::atomic<States> state_{EMPTY};
+    std::atomic<float> phase_{0.0f};
+    std::atomic<bool> clear_requested_{false};
+    size_t length_ = 0;
+    size_t position_ = 0;
+    float punch_ = 0;
+
+    float working_[WAVEFORM_RESOLUTION];
+    static const int FRESH = 4;  // Shared buffer flag, set until the reader takes it.
+    float waveforms_[3][WAVEFORM_RESOLUTION] = {};
+    int waveform_back_ = 0;                // Audio thread.
+    std::atomic<int> waveform_shared_{1};
+    int waveform_front_ = 2;               // Display thread.
+    int bin_ = 0;
+    float bin_peak_ = 0;
+};
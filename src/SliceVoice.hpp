@@ -0,0 +1,54 @@
+// One shot voice playing a slice of a clip. Voices live in a preallocated pool.
+struct SliceVoice
+{
+    static constexpr float FADE_TIME = 0.002f;  // Release ramp before the slice end, in seconds.
+
+    bool playing_ = false;
+    LutEnvelope env_;
+
+    // Slice bounds in clip samples.
+    void trigger(uint32_t start, uint32_t end)
+    {
+        playing_ = end > start;
+        index_ = start;
+        end_ = end;
+        env_.tigger(true);
+        antipop_.trigger();
+    }
+
+    // increment in clip samples per engine sample.
+    inline float process(AudioClip &clip, Interpolations interpolation_mode, double increment, float sample_time)
+    {
+        if (!playing_)
+            return 0;
+
+        // Keep the 4 point kernels inside the clip.
+        const double end = std::min(end_, clip.getSampleCount() - 3.0);
+        if (index_ >= end) {
+            playing_ = false;
+            return 0;
+        }
+
+        // Ramp down over the last FADE_TIME, so the slice never stops on a step.
+        const double remaining = (end - index_) / std::max(increment, 1e-6);
+        const float fade = std::min((float)remaining * sample_time / FADE_TIME, 1.0f);
+
+        float clip_sample = clip.getSampleIndex(std::max(index_, 1.0), interpolation_mode);
+        index_ += increment;
+
+        float env_level = env_.process(sample_time);
+        return antipop_.process(clip_sample * env_level * fade, sample_time);
+    }
+
+    // Read position for display, in clip samples.
+    double getIndex()
+    {
+        return index_;
+    }
+
+private:
+
+    double index_ = 0;
+    double end_ = 0;
+    AntipopFilter antipop_;
+};
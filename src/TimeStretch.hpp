@@ -0,0 +1,128 @@
+// WSOLA time stretching on top of an AudioClip. Speed and pitch are independent.
+// Frames of FRAME_SIZE samples are overlap added every HOP_SIZE output samples.
+// Each frame start is searched around its ideal position for the best match
+// with the natural continuation of the previous frame, using the clip's
+// decimated signal. The search size is fixed, so the cost per frame is bounded.
+struct TimeStretch
+{
+    static const int FRAME_SIZE = 1024;
+    static const int HOP_SIZE = FRAME_SIZE / 2;
+    static const int SEARCH_RANGE = 256;  // Clip samples on each side.
+    static const int SEARCH_STEP = 2;     // Decimated samples between candidates.
+
+    float speed_ = 1.0f;  // Playback speed. Negative plays backwards.
+    float pitch_ = 1.0f;  // Playback rate relative to the clip sample rate.
+
+    // Start reading at position, in clip samples.
+    void reset(double position) {
+        analysis_index_ = position;
+        previous_index_ = position;
+        previous_increment_ = 0;
+        output_index_ = HOP_SIZE;
+        for (int i = 0; i < FRAME_SIZE; i++)
+            output_[i] = 0;
+    }
+
+    // Region in clip samples. Returns false when the read position leaves it.
+    bool process(AudioClip &clip, Interpolations interpolation_mode, float sample_time, double min_index, double max_index, bool looping, float *out) {
+        bool inside = true;
+
+        if (output_index_ >= HOP_SIZE) {
+            const double rate = clip.getSampleRate() * sample_time;
+
+            // Advance and wrap the analysis position.
+            analysis_index_ += HOP_SIZE * speed_ * rate;
+            if (analysis_index_ >= max_index || analysis_index_ < min_index) {
+                inside = looping;
+                analysis_index_ = speed_ >= 0 ? min_index : max_index;
+                previous_increment_ = 0;
+            }
+
+            double increment = pitch_ * rate;
+            double start = findFrameStart(clip, min_index, max_index, increment);
+            addFrame(clip, interpolation_mode, start, increment);
+
+            previous_index_ = start;
+            previous_increment_ = increment;
+            output_index_ = 0;
+        }
+
+        *out = output_[output_index_++];
+        return inside;
+    }
+
+    // Read position for display, in clip samples.
+    double getIndex() {
+        return analysis_index_;
+    }
+
+private:
+
+    float output_[FRAME_SIZE];
+    int output_index_ = HOP_SIZE;
+    double analysis_index_ = 0;
+    double previous_index_ = 0;
+    double previous_increment_ = 0;
+
+    double findFrameStart(AudioClip &clip, double min_index, double max_index, double increment) {
+        // Nothing to continue after a reset or a wrap.
+        if (previous_increment_ == 0)
+            return analysis_index_;
+
+        const std::vector<float> &decimated = clip.getDecimated();
+        const int decimated_count = decimated.size();
+        const int length = HOP_SIZE / ANALYSIS_DECIMATION;
+        const double step = increment;
+
+        // Where the previous frame would naturally continue.
+        double natural = (previous_index_ + HOP_SIZE * previous_increment_) / ANALYSIS_DECIMATION;
+
+        double best_index = analysis_index_;
+        float best_score = -INFINITY;
+        const int range = SEARCH_RANGE / ANALYSIS_DECIMATION;
+        const double center = analysis_index_ / ANALYSIS_DECIMATION;
+
+        for (int offset = -range; offset <= range; offset += SEARCH_STEP) {
+            double candidate = center + offset;
+            if (candidate * ANALYSIS_DECIMATION < min_index || candidate * ANALYSIS_DECIMATION >= max_index)
+                continue;
+
+            if ((int)(candidate + length * step) >= decimated_count || (int)(natural + length * step) >= decimated_count)
+                continue;
+
+            float correlation = 0;
+            float energy = 1e-6f;
+            for (int i = 0; i < length; i++) {
+                float a = decimated[(int)(candidate + i * step)];
+                float b = decimated[(int)(natural + i * step)];
+                correlation += a * b;
+                energy += a * a;
+            }
+
+            float score = correlation / std::sqrt(energy);
+            if (score > best_score) {
+                best_score = score;
+                best_index = candidate * ANALYSIS_DECIMATION;
+            }
+        }
+
+        return best_index;
+    }
+
+    void addFrame(AudioClip &clip, Interpolations interpolation_mode, double start, double increment) {
+        // Shift out the samples already played.
+        for (int i = 0; i < HOP_SIZE; i++) {
+            output_[i] = output_[i + HOP_SIZE];
+            output_[i + HOP_SIZE] = 0;
+        }
+
+        // Keep the 4 point kernels inside the clip.
+        const double min_index = 1;
+        const double max_index = clip.getSampleCount() - 3;
+        const float window_scale = 256.0f / FRAME_SIZE;
+        for (int i = 0; i < FRAME_SIZE; i++) {
+            double index = std::min(std::max(start + i * increment, min_index), max_index);
+            output_[i] += clip.getSampleIndex(index, interpolation_mode) * interpolateLinear(grain_window_hann, i * window_scale);
+        }
+    }
+};
@@ -33,6 +33,10 @@ plt.show()
 numpy.savetxt("ENV_EXPO", env_expo, fmt = '%.6f',  newline ='f,',)
 numpy.savetxt("ENV_QUARTIC", env_quartic, fmt = '%.6f',  newline ='f,',)
 
+# Grain window. 257 points, last one repeats the first for interpolation.
+grain_window_hann = numpy.sin(numpy.pi * numpy.arange(0, 257.0) / 256.0) ** 2
+numpy.savetxt("GRAIN_WINDOW_HANN", grain_window_hann, fmt = '%.6f',  newline ='f,',)
+
 #import matplotlib.pyplot as plt
 #import numpy as np
 
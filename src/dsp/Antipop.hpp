@@ -8,12 +8,16 @@ struct AntipopFilter {
     }
 
     float process(float in, const Module::ProcessArgs &args) {
+        return process(in, args.sampleTime);
+    }
+
+    float process(float in, float delta_time) {
         if (alpha_ >= 1.0f) {
             filter_ = in;
             return in;
         }
 
-        alpha_ += args.sampleTime * 1500; //  (args.sampleRate / 32);
+        alpha_ += delta_time * 1500; //  (args.sampleRate / 32);
        
         filter_ += alpha_ * (in - filter_);
 
@@ -31,6 +31,16 @@ inline float Hermite4pt3oX(float x0, float x1, float x2, float x3, float t)
     return (((((c3 * t) + c2) * t) + c1) * t) + c0;
 }
 
+// Four Hermite interpolations at once, one per lane.
+inline simd::float_4 Hermite4pt3oX(simd::float_4 x0, simd::float_4 x1, simd::float_4 x2, simd::float_4 x3, simd::float_4 t)
+{
+    simd::float_4 c0 = x1;
+    simd::float_4 c1 = .5F * (x2 - x0);
+    simd::float_4 c2 = x0 - (2.5F * x1) + (2.f * x2) - (.5F * x3);
+    simd::float_4 c3 = (.5F * (x3 - x0)) + (1.5F * (x1 - x2));
+    return (((((c3 * t) + c2) * t) + c1) * t) + c0;
+}
+
 /** Double precission index `x`.
 The array at `p` must be at least length `floor(x) + 2`.
 */
@@ -40,7 +50,8 @@ inline float interpolateLinearD(float* data, double index) {
     return crossfade(data[x1], data[x1+1], t);
 }
 
-/** The array at `p` must be at least length `floor(x) + 3`.
+/** Reads `data[floor(x) - 1]` to `data[floor(x) + 2]`.
+Callers near the ends need guard samples, see AudioClip::GUARD.
 */
 inline float InterpolateHermite(float* data, double index) {
     int x1 = floor(index);
@@ -48,7 +59,8 @@ inline float InterpolateHermite(float* data, double index) {
     return Hermite4pt3oX(data[x1 - 1], data[x1], data[x1 + 1], data[x1 + 2], t);
 }
 
-/** The array at `p` must be at least length `floor(x) + 3`.
+/** Reads `data[floor(x) - 1]` to `data[floor(x) + 2]`.
+Callers near the ends need guard samples, see AudioClip::GUARD.
 */
 inline float interpolateBSpline(const float* data, double index) {
     int x1 = floor(index);
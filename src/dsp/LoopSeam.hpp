@@ -0,0 +1,93 @@
+// Crossfaded loop seam. The last `length` samples before the loop end fade
+// into the first `length` samples after the loop start. Playing forward the
+// seam replaces [end - length, end) and playback continues at start + length.
+// Playing backwards it replaces [start, start + length) and playback
+// continues at end - length. Built once per loop points, so wrapping costs
+// nothing per sample.
+struct LoopSeam
+{
+    static const int MAX_LENGTH = 2048;
+
+    // Rebuild only after the same loop points were requested `settle_updates` times in a row.
+    // clip is the clip's generation, a reloaded slot never matches the old seam.
+    bool update(const float *data, int count, uint32_t clip, int start, int end, int length, int settle_updates)
+    {
+        if (clip == clip_ && start == start_ && end == end_ && count == count_)
+            return true;
+
+        if (clip != pending_clip_ || start != pending_start_ || end != pending_end_) {
+            pending_clip_ = clip;
+            pending_start_ = start;
+            pending_end_ = end;
+            settle_ = 0;
+            return false;
+        }
+
+        if (++settle_ < settle_updates)
+            return false;
+
+        length = std::min(std::min(length, (int)MAX_LENGTH), (end - start) / 2);
+        if (length < 4)
+            return false;
+
+        build(data, count, start, end, length);
+        clip_ = clip;
+        start_ = start;
+        end_ = end;
+        count_ = count;
+        return true;
+    }
+
+    // Index from 0 to getLength().
+    inline float read(double index, Interpolations interpolation_mode)
+    {
+        float *seam = data_ + GUARD;
+        switch (interpolation_mode) {
+        case NONE:
+            return seam[(int)floor(index)];
+        case LINEAR:
+            return interpolateLinearD(seam, index);
+        case HERMITE:
+            return InterpolateHermite(seam, index);
+        case BSPLINE:
+            return interpolateBSpline(seam, index);
+        default:
+            return seam[(int)floor(index)];
+        }
+    }
+
+    int getLength()
+    {
+        return length_;
+    }
+
+private:
+
+    // Room for the 4 point kernels at both ends.
+    static const int GUARD = 2;
+
+    float data_[MAX_LENGTH + GUARD * 2];
+    int length_ = 0;
+
+    uint32_t clip_ = 0;
+    int start_ = -1;
+    int end_ = -1;
+    int count_ = 0;
+
+    uint32_t pending_clip_ = 0;
+    int pending_start_ = -1;
+    int pending_end_ = -1;
+    int settle_ = 0;
+
+    void build(const float *data, int count, int start, int end, int length)
+    {
+        // Equal power crossfade.
+        for (int i = -GUARD; i < length + GUARD; i++) {
+            float fade = clamp((float)i / length, 0.0f, 1.0f) * (float)M_PI_2;
+            float tail = data[clamp(end - length + i, 0, count - 1)];
+            float head = data[clamp(start + i, 0, count - 1)];
+            data_[i + GUARD] = tail * cosf(fade) + head * sinf(fade);
+        }
+        length_ = length;
+    }
+};
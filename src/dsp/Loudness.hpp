@@ -0,0 +1,129 @@
+// Peak, RMS and integrated loudness (ITU-R BS.1770) of a mono clip.
+// Slow, meant for the analysis worker thread.
+struct Loudness
+{
+    float peak = 0;
+    float rms = 0;
+    float lufs = -70.0f;  // Silence reads as the absolute gate.
+
+    void measure(const float *data, int count, int sample_rate)
+    {
+        peak = 0;
+        rms = 0;
+        lufs = -70.0f;
+        if (count <= 0 || sample_rate <= 0)
+            return;
+
+        double sum = 0;
+        for (int i = 0; i < count; i++) {
+            peak = std::max(peak, std::fabs(data[i]));
+            sum += (double)data[i] * data[i];
+        }
+        rms = std::sqrt(sum / count);
+
+        // K weighted mean square of 400ms blocks with 75% overlap.
+        std::vector<double> weighted(count);
+        Biquad shelf = highShelf(sample_rate);
+        Biquad highpass = highPass(sample_rate);
+        for (int i = 0; i < count; i++)
+            weighted[i] = highpass.process(shelf.process(data[i]));
+
+        const int block = 0.4 * sample_rate;
+        const int step = block / 4;
+        std::vector<double> blocks;
+        for (int start = 0; start + block <= count; start += step) {
+            double power = 0;
+            for (int i = start; i < start + block; i++)
+                power += weighted[i] * weighted[i];
+            blocks.push_back(power / block);
+        }
+
+        // Clips shorter than one block are measured as a single block.
+        if (blocks.empty()) {
+            double power = 0;
+            for (int i = 0; i < count; i++)
+                power += weighted[i] * weighted[i];
+            blocks.push_back(power / count);
+        }
+
+        // Absolute gate at -70 LUFS, then relative gate 10 LU below.
+        double gated = gatedMean(blocks, -70.0);
+        if (gated <= 0)
+            return;
+        gated = gatedMean(blocks, toLufs(gated) - 10.0);
+        if (gated <= 0)
+            return;
+
+        lufs = toLufs(gated);
+    }
+
+private:
+
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+        double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+
+        double process(double x) {
+            double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            return y;
+        }
+    };
+
+    static double toLufs(double power)
+    {
+        return -0.691 + 10.0 * std::log10(power);
+    }
+
+    static double gatedMean(const std::vector<double> &blocks, double gate_lufs)
+    {
+        double sum = 0;
+        int count = 0;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (blocks[i] > 0 && toLufs(blocks[i]) > gate_lufs) {
+                sum += blocks[i];
+                count++;
+            }
+        }
+        return count > 0 ? sum / count : 0;
+    }
+
+    // +4dB above 1.5kHz. Head acoustics.
+    static Biquad highShelf(int sample_rate)
+    {
+        const double A = std::pow(10.0, 4.0 / 40.0);
+        const double w0 = 2.0 * M_PI * 1500.0 / sample_rate;
+        const double alpha = std::sin(w0) / (2.0 * M_SQRT1_2);
+        const double cosw = std::cos(w0);
+        const double sqrtA = std::sqrt(A);
+
+        const double a0 = (A + 1) - (A - 1) * cosw + 2 * sqrtA * alpha;
+        Biquad biquad;
+        biquad.b0 = A * ((A + 1) + (A - 1) * cosw + 2 * sqrtA * alpha) / a0;
+        biquad.b1 = -2 * A * ((A - 1) + (A + 1) * cosw) / a0;
+        biquad.b2 = A * ((A + 1) + (A - 1) * cosw - 2 * sqrtA * alpha) / a0;
+        biquad.a1 = 2 * ((A - 1) - (A + 1) * cosw) / a0;
+        biquad.a2 = ((A + 1) - (A - 1) * cosw - 2 * sqrtA * alpha) / a0;
+        return biquad;
+    }
+
+    // 38Hz high pass. RLB weighting.
+    static Biquad highPass(int sample_rate)
+    {
+        const double w0 = 2.0 * M_PI * 38.0 / sample_rate;
+        const double alpha = std::sin(w0) / (2.0 * 0.5);
+        const double cosw = std::cos(w0);
+
+        const double a0 = 1 + alpha;
+        Biquad biquad;
+        biquad.b0 = (1 + cosw) / 2 / a0;
+        biquad.b1 = -(1 + cosw) / a0;
+        biquad.b2 = (1 + cosw) / 2 / a0;
+        biquad.a1 = -2 * cosw / a0;
+        biquad.a2 = (1 - alpha) / a0;
+        return biquad;
+    }
+};
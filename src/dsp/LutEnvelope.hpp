@@ -59,6 +59,7 @@ struct LutEnvelope
         configureStage(0,   1.0f,  interpolateLinear(env_time_, attack * 255),  attack_shape);// Attack Linear / Exponential
         configureStage(1,   0.0f,  interpolateLinear(env_time_, decay  * 255),  decay_shape); // Decay  Exponential
         configureStage(2,   0.0f,  0.0f,                                        1.0f);        // Off    Linear
+        off_stage_ = 2;
     }
 
     void envelopeHD(float hold, float decay, float decay_shape = 2.99999f)
@@ -68,6 +69,7 @@ struct LutEnvelope
         configureStage(1,   1.0f,  interpolateLinear(env_time_, hold * 255),   1.0f);     // Hold   Linear
         configureStage(2,   0.0f,  interpolateLinear(env_time_, decay * 255),  decay_shape); // Decay  Exponential
         configureStage(3,   0.0f,  0.0f,                                       1.0f);     // Off    Linear
+        off_stage_ = 3;
     }
 
     // To set a segment time with a 0 to 1 input the envelope has to calculate
@@ -87,11 +89,24 @@ struct LutEnvelope
         return pow(max_time / min_time, -time) / min_time;
     }
 
+    // Last value returned by process().
+    float getValue()
+    {
+        return value_;
+    }
+
+    // True once the last configured stage is reached.
+    bool isDone()
+    {
+        return stage_ >= off_stage_;
+    }
+
     enum EnvShape { QUARTIC, LINEAR, EXPONENTIAL, EXPONENTIAL_8, NUM_ENV_SHAPES };
 
 private:
 
     int stage_ = 0;
+    int off_stage_ = 3;
     float phase_ = 0;
     float value_ = 0;
     float start_value_ = 0;
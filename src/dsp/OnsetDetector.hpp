@@ -0,0 +1,105 @@
+// Spectral flux onset detector. Slow, meant for the analysis worker thread.
+struct OnsetDetector
+{
+    static const int FFT_SIZE = 1024;
+    static const int HOP_SIZE = 256;
+
+    OnsetDetector() : fft_(FFT_SIZE)
+    {
+        for (int i = 0; i < FFT_SIZE; i++)
+            window_[i] = interpolateLinear(grain_window_hann, i * (256.0f / FFT_SIZE));
+    }
+
+    // Spectral flux every HOP_SIZE samples. Frames are centered on i * HOP_SIZE.
+    void calculateFlux(const float *data, int count, std::vector<float> &flux)
+    {
+        const int frames = count / HOP_SIZE + 1;
+        flux.assign(frames, 0.0f);
+
+        for (int k = 0; k < FFT_SIZE / 2; k++)
+            previous_[k] = 0;
+
+        for (int f = 0; f < frames; f++) {
+            const int offset = f * HOP_SIZE - FFT_SIZE / 2;
+            for (int i = 0; i < FFT_SIZE; i++) {
+                int index = offset + i;
+                input_[i] = (index >= 0 && index < count) ? data[index] * window_[i] : 0.0f;
+            }
+
+            fft_.rfft(input_, spectrum_);
+
+            // Log compressed magnitudes. Skip DC and Nyquist.
+            float sum = 0;
+            for (int k = 1; k < FFT_SIZE / 2; k++) {
+                float re = spectrum_[2 * k];
+                float im = spectrum_[2 * k + 1];
+                float magnitude = logf(1.0f + 10.0f * std::sqrt(re * re + im * im));
+                sum += std::max(0.0f, magnitude - previous_[k]);
+                previous_[k] = magnitude;
+            }
+            flux[f] = sum;
+        }
+    }
+
+    // Slices start at each onset. The first one always starts at 0.
+    void detect(const float *data, int count, int sample_rate, SliceTable &table)
+    {
+        table.clear();
+        table.addSliceStart(0, count);
+        flux_.clear();
+
+        if (count < FFT_SIZE)
+            return;
+
+        std::vector<float> &flux = flux_;
+        calculateFlux(data, count, flux);
+        const int frames = flux.size();
+
+        float mean = 0;
+        for (int f = 0; f < frames; f++)
+            mean += flux[f];
+        mean /= frames;
+
+        // Peaks above a local average, at least 50ms apart.
+        const int radius = 8;
+        const int min_gap = 0.05f * sample_rate;
+        int last_onset = 0;
+        for (int f = 1; f < frames - 1; f++) {
+            if (flux[f] < flux[f - 1] || flux[f] <= flux[f + 1])
+                continue;
+
+            float local = 0;
+            int first = std::max(0, f - radius);
+            int last = std::min(frames - 1, f + radius);
+            for (int i = first; i <= last; i++)
+                local += flux[i];
+            local /= (last - first + 1);
+
+            if (flux[f] < local * 1.5f + mean * 0.1f)
+                continue;
+
+            // A little early, to keep the attack.
+            int onset = std::max(0, f * HOP_SIZE - HOP_SIZE);
+            if (onset - last_onset < min_gap)
+                continue;
+
+            table.addSliceStart(onset, count);
+            last_onset = onset;
+        }
+    }
+
+    // Onset envelope of the last detect() call, one value per HOP_SIZE samples.
+    const std::vector<float> &getFlux()
+    {
+        return flux_;
+    }
+
+private:
+
+    std::vector<float> flux_;
+    dsp::RealFFT fft_;
+    alignas(16) float input_[FFT_SIZE];
+    alignas(16) float spectrum_[FFT_SIZE];
+    float window_[FFT_SIZE];
+    float previous_[FFT_SIZE / 2];
+};
@@ -0,0 +1,83 @@
+// Min/max summaries of a clip from MIN_BINS to MAX_BINS bins, each level
+// twice the bins of the previous one. No level is finer than the samples.
+// Peaks are stored as 16 bit, half a megabyte for the longest clips.
+struct PeakPyramid
+{
+    static const int MIN_BINS = 64;
+    static const int MAX_LEVELS = 11;  // 64 to 65536 bins.
+
+    // Finest level from the samples, the others from pairs of finer bins. O(n).
+    void build(const float *data, int count)
+    {
+        levels_ = 0;
+        while (levels_ < MAX_LEVELS && getBins(levels_) <= count)
+            levels_++;
+
+        if (levels_ == 0)
+            return;
+
+        const int finest = levels_ - 1;
+        const int bins = getBins(finest);
+        min_[finest].resize(bins);
+        max_[finest].resize(bins);
+        for (int i = 0; i < bins; i++) {
+            const int start = (int64_t)i * count / bins;
+            const int end = (int64_t)(i + 1) * count / bins;
+            float lo = data[start];
+            float hi = data[start];
+            for (int s = start + 1; s < end; s++) {
+                lo = std::min(lo, data[s]);
+                hi = std::max(hi, data[s]);
+            }
+            min_[finest][i] = quantize(lo);
+            max_[finest][i] = quantize(hi);
+        }
+
+        for (int level = finest - 1; level >= 0; level--) {
+            const int level_bins = getBins(level);
+            min_[level].resize(level_bins);
+            max_[level].resize(level_bins);
+            for (int i = 0; i < level_bins; i++) {
+                min_[level][i] = std::min(min_[level + 1][2 * i], min_[level + 1][2 * i + 1]);
+                max_[level][i] = std::max(max_[level + 1][2 * i], max_[level + 1][2 * i + 1]);
+            }
+        }
+    }
+
+    // 0 until built, or for clips shorter than MIN_BINS.
+    int getLevelCount() { return levels_; }
+
+    static int getBins(int level) { return MIN_BINS << level; }
+
+    // Coarsest level with at least bins bins, else the finest.
+    int getLevel(int bins)
+    {
+        int level = 0;
+        while (level < levels_ - 1 && getBins(level) < bins)
+            level++;
+        return level;
+    }
+
+    // Min and max over bins [start, end) of a level.
+    void getRange(int level, int start, int end, float *lo, float *hi)
+    {
+        int16_t min = min_[level][start];
+        int16_t max = max_[level][start];
+        for (int i = start + 1; i < end; i++) {
+            min = std::min(min, min_[level][i]);
+            max = std::max(max, max_[level][i]);
+        }
+        *lo = min / 32767.0f;
+        *hi = max / 32767.0f;
+    }
+
+private:
+    static int16_t quantize(float x)
+    {
+        return (int16_t)roundf(clamp(x, -1.0f, 1.0f) * 32767.0f);
+    }
+
+    std::vector<int16_t> min_[MAX_LEVELS];
+    std::vector<int16_t> max_[MAX_LEVELS];
+    int levels_ = 0;
+};
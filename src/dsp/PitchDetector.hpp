@@ -0,0 +1,58 @@
+// YIN fundamental estimate on one window of a clip, 40Hz to 4kHz. Returns 0Hz
+// when nothing is periodic enough, like most drums. Worker thread only.
+struct PitchDetector
+{
+    static const int WINDOW_SIZE = 2048;
+    static const int MIN_FREQUENCY = 40;
+    static const int MAX_FREQUENCY = 4000;
+
+    PitchDetector() : difference_(WINDOW_SIZE + 1)
+    {
+    }
+
+    // The window starts at offset, or earlier for short clips.
+    float detect(const float *data, int count, float sample_rate, int offset)
+    {
+        const int max_tau = std::min((int)(sample_rate / MIN_FREQUENCY), (int)WINDOW_SIZE);
+        const int min_tau = std::max(2, (int)(sample_rate / MAX_FREQUENCY));
+        offset = std::min(offset, count - WINDOW_SIZE - max_tau - 1);
+        if (offset < 0)
+            return 0;
+
+        const float *x = data + offset;
+
+        // Cumulative mean normalized difference.
+        difference_[0] = 1;
+        float running_sum = 0;
+        for (int tau = 1; tau <= max_tau; tau++) {
+            float sum = 0;
+            for (int j = 0; j < WINDOW_SIZE; j++) {
+                const float delta = x[j] - x[j + tau];
+                sum += delta * delta;
+            }
+            running_sum += sum;
+            difference_[tau] = running_sum > 0 ? sum * tau / running_sum : 1;
+        }
+
+        // First dip under the threshold, then down to its minimum.
+        int tau = min_tau;
+        while (tau < max_tau && difference_[tau] >= THRESHOLD)
+            tau++;
+        if (tau >= max_tau)
+            return 0;
+        while (tau + 1 < max_tau && difference_[tau + 1] < difference_[tau])
+            tau++;
+
+        float period = tau;
+        const float denominator = difference_[tau - 1] - 2 * difference_[tau] + difference_[tau + 1];
+        if (denominator > 0)
+            period += 0.5f * (difference_[tau - 1] - difference_[tau + 1]) / denominator;
+
+        return sample_rate / period;
+    }
+
+private:
+
+    static constexpr float THRESHOLD = 0.15f;
+    std::vector<float> difference_;
+};
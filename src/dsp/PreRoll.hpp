@@ -0,0 +1,44 @@
+// The last frames of a polyphonic signal. Sized up front, push overwrites the oldest.
+struct PreRoll {
+    static const int WIDTH = 16;  // Floats per frame, one per channel.
+
+    void allocate(int capacity) {
+        capacity_ = std::max(capacity, 1);
+        buffer_.assign(capacity_ * WIDTH, 0.0f);
+        clear();
+    }
+
+    void clear() {
+        write_ = 0;
+        count_ = 0;
+    }
+
+    inline void push(const float *frame) {
+        std::copy(frame, frame + WIDTH, &buffer_[write_ * WIDTH]);
+        if (++write_ == capacity_)
+            write_ = 0;
+        if (count_ < capacity_)
+            count_++;
+    }
+
+    // Calls f with the last length frames, oldest first.
+    template <typename F>
+    void drain(int length, F f) {
+        length = std::min(length, count_);
+        int read = write_ - length;
+        if (read < 0)
+            read += capacity_;
+        for (int i = 0; i < length; i++) {
+            f(&buffer_[read * WIDTH]);
+            if (++read == capacity_)
+                read = 0;
+        }
+        clear();
+    }
+
+private:
+    std::vector<float> buffer_ = std::vector<float>(WIDTH, 0.0f);
+    int capacity_ = 1;
+    int write_ = 0;
+    int count_ = 0;
+};
@@ -0,0 +1,40 @@
+// Flat table of slices in clip samples. Slice i plays from start to end.
+struct SliceTable
+{
+    static const int MAX_SLICES = 256;
+
+    struct Slice {
+        uint32_t start;
+        uint32_t end;
+    };
+
+    Slice slices_[MAX_SLICES];
+    int count_ = 0;
+
+    void clear()
+    {
+        count_ = 0;
+    }
+
+    // Slices are contiguous: each one ends where the next one starts.
+    void addSliceStart(uint32_t start, uint32_t clip_end)
+    {
+        if (count_ >= MAX_SLICES)
+            return;
+
+        if (count_ > 0)
+            slices_[count_ - 1].end = start;
+
+        slices_[count_].start = start;
+        slices_[count_].end = clip_end;
+        count_++;
+    }
+
+    // Boundary 0 to count_. The last one is the end of the last slice. O(1).
+    uint32_t getBoundary(int index)
+    {
+        if (index >= count_)
+            return slices_[count_ - 1].end;
+        return slices_[index].start;
+    }
+};
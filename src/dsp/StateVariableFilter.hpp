@@ -0,0 +1,59 @@
+enum FilterModes {
+    NO_FILTER,
+    LOWPASS_FILTER,
+    BANDPASS_FILTER,
+    HIGHPASS_FILTER,
+    NUM_FILTER_MODES
+};
+
+// Trapezoidal state variable filter, after Andrew Simper. T is float or
+// simd::float_4 with one voice per lane. Coefficients are set at control rate.
+template <typename T>
+struct StateVariableFilter
+{
+    void reset()
+    {
+        ic1eq_ = 0;
+        ic2eq_ = 0;
+    }
+
+    // cutoff in Hz, below Nyquist. damping is 1 / Q.
+    void setCoefficients(T cutoff, T damping, float sample_time)
+    {
+        using std::tan;
+        const T g = tan(cutoff * (float)(M_PI * sample_time));
+        k_ = damping;
+        a1_ = 1.0f / (1.0f + g * (g + k_));
+        a2_ = g * a1_;
+        a3_ = g * a2_;
+    }
+
+    T process(T in, FilterModes mode)
+    {
+        const T v3 = in - ic2eq_;
+        const T v1 = a1_ * ic1eq_ + a2_ * v3;
+        const T v2 = ic2eq_ + a2_ * ic1eq_ + a3_ * v3;
+        ic1eq_ = 2.0f * v1 - ic1eq_;
+        ic2eq_ = 2.0f * v2 - ic2eq_;
+
+        switch (mode) {
+        case BANDPASS_FILTER:
+            return v1;
+        case HIGHPASS_FILTER:
+            return in - k_ * v1 - v2;
+        case LOWPASS_FILTER:
+            return v2;
+        default:
+            return in;
+        }
+    }
+
+private:
+
+    T ic1eq_ = 0;
+    T ic2eq_ = 0;
+    T k_ = 2.0f;
+    T a1_ = 1.0f;
+    T a2_ = 0;
+    T a3_ = 0;
+};
@@ -0,0 +1,66 @@
+// Tempo of a loop from its onset envelope. The autocorrelation is scored for
+// every lag between MAX_BPM and MIN_BPM, weighted towards 120 BPM to settle
+// octave errors, and the best lag refined with a parabola. When a whole number of beats over the clip is within 3% of that,
+// the tempo snaps to it, since trimmed loops usually are. Worker thread only.
+struct TempoEstimator
+{
+    static const int MIN_BPM = 60;
+    static const int MAX_BPM = 180;
+
+    // Flux values are hop_time seconds apart. 0 BPM when there is no clear beat.
+    static float estimate(const std::vector<float> &flux, float hop_time, float duration)
+    {
+        const int frames = flux.size();
+        const int min_lag = std::max(1, (int)(60.0f / (MAX_BPM * hop_time)));
+        const int max_lag = (int)ceilf(60.0f / (MIN_BPM * hop_time));
+        if (max_lag + 2 >= frames)
+            return 0;
+
+        float mean = 0;
+        for (int f = 0; f < frames; f++)
+            mean += flux[f];
+        mean /= frames;
+
+        std::vector<float> x(frames);
+        for (int f = 0; f < frames; f++)
+            x[f] = flux[f] - mean;
+
+        std::vector<float> acf(max_lag + 2, 0.0f);
+        for (int lag = 0; lag <= max_lag + 1; lag++) {
+            float sum = 0;
+            for (int f = 0; f + lag < frames; f++)
+                sum += x[f] * x[f + lag];
+            acf[lag] = sum / (frames - lag);
+        }
+
+        // Log normal prior, one octave wide.
+        int best = min_lag;
+        float best_score = -INFINITY;
+        for (int lag = min_lag; lag <= max_lag; lag++) {
+            const float octaves = log2f(60.0f / (lag * hop_time * 120.0f));
+            const float score = acf[lag] * expf(-0.5f * octaves * octaves);
+            if (score > best_score) {
+                best = lag;
+                best_score = score;
+            }
+        }
+
+        if (acf[0] <= 0 || acf[best] < 0.1f * acf[0])
+            return 0;
+
+        float lag = best;
+        const float denominator = acf[best - 1] - 2 * acf[best] + acf[best + 1];
+        if (best > 1 && denominator < 0)
+            lag += 0.5f * (acf[best - 1] - acf[best + 1]) / denominator;
+
+        float bpm = 60.0f / (lag * hop_time);
+
+        const float beats = roundf(duration * bpm / 60.0f);
+        if (beats >= 1) {
+            const float fitted = beats * 60.0f / duration;
+            if (fabsf(fitted - bpm) < 0.03f * bpm)
+                bpm = fitted;
+        }
+        return bpm;
+    }
+};
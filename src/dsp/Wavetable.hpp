@@ -0,0 +1,121 @@
+// Band limited wavetable built from a clip. The clip is split in frames and
+// each frame is resampled to one TABLE_SIZE cycle, stored as mip levels.
+// Clips with more than MAX_FRAMES frames keep MAX_FRAMES of them, evenly
+// picked, so every frame stays one whole source cycle.
+// Level L keeps the harmonics below (TABLE_SIZE / 2) >> L. All levels share
+// the same size and guard samples, so two frames and two levels are read with
+// a single float_4 Hermite kernel. Slow to build, meant for a worker thread.
+struct Wavetable
+{
+    static const int TABLE_SIZE = 2048;
+    static const int MAX_LEVELS = 10;
+    static const int MAX_FRAMES = 64;
+    static const int STRIDE = TABLE_SIZE + 4;  // One guard sample before the cycle, three after.
+
+    Wavetable() : fft_(TABLE_SIZE)
+    {
+    }
+
+    int getFrameCount() { return frame_count_; }
+
+    // source_frames is the number of frames the clip is split in.
+    void build(const float *data, int count, int source_frames, int levels)
+    {
+        source_frames = std::max(source_frames, 1);
+        const int frames = std::min(source_frames, (int)MAX_FRAMES);
+        levels = clamp(levels, 1, (int)MAX_LEVELS);
+        frame_count_ = 0;
+        if (count < source_frames * 4)
+            return;
+
+        level_count_ = levels;
+        tables_.resize(frames * levels * STRIDE);
+
+        const double frame_length = (double)count / source_frames;
+        for (int f = 0; f < frames; f++) {
+            // First and last frames are always kept.
+            const int source = frames > 1 ? (int64_t)f * (source_frames - 1) / (frames - 1) : 0;
+
+            // One frame into one cycle. Linear is enough, the spectrum is cut below.
+            const int frame_end = std::min((int)((source + 1) * frame_length), count) - 1;
+            for (int i = 0; i < TABLE_SIZE; i++) {
+                const double index = source * frame_length + i * frame_length / TABLE_SIZE;
+                const int x1 = std::min((int)index, frame_end);
+                input_[i] = crossfade(data[x1], data[std::min(x1 + 1, frame_end)], (float)(index - x1));
+            }
+
+            fft_.rfft(input_, spectrum_);
+            spectrum_[0] = 0;  // DC.
+            spectrum_[1] = 0;  // Nyquist.
+
+            for (int l = 0; l < levels; l++) {
+                // Levels only remove harmonics, cut the spectrum in place.
+                for (int k = (TABLE_SIZE / 2) >> l; k < TABLE_SIZE / 2; k++) {
+                    spectrum_[2 * k] = 0;
+                    spectrum_[2 * k + 1] = 0;
+                }
+                fft_.irfft(spectrum_, input_);
+
+                float *table = getTable(f, l);
+                for (int i = 0; i < TABLE_SIZE; i++)
+                    table[i + 1] = input_[i] / TABLE_SIZE;
+                table[0] = table[TABLE_SIZE];
+                table[TABLE_SIZE + 1] = table[1];
+                table[TABLE_SIZE + 2] = table[2];
+                table[TABLE_SIZE + 3] = table[3];
+            }
+        }
+
+        frame_count_ = frames;
+    }
+
+    // phase in [0, 1], position in [0, 1] across the frames, increment in cycles per sample.
+    float process(float phase, float position, float increment)
+    {
+        if (frame_count_ == 0)
+            return 0;
+
+        const float frame = position * (frame_count_ - 1);
+        const int f0 = (int)frame;
+        const int f1 = std::min(f0 + 1, frame_count_ - 1);
+        const float frame_t = frame - f0;
+
+        // One level above the limit, so the pair never aliases.
+        const float level = clamp(log2f(fabsf(increment) * TABLE_SIZE) + 1.0f, 0.0f, (float)(level_count_ - 1));
+        const int l0 = (int)level;
+        const int l1 = std::min(l0 + 1, level_count_ - 1);
+        const float level_t = level - l0;
+
+        const float index = phase * TABLE_SIZE;
+        const int i = (int)index;
+        const float *p0 = getTable(f0, l0) + i;
+        const float *p1 = getTable(f0, l1) + i;
+        const float *p2 = getTable(f1, l0) + i;
+        const float *p3 = getTable(f1, l1) + i;
+
+        simd::float_4 x0(p0[0], p1[0], p2[0], p3[0]);
+        simd::float_4 x1(p0[1], p1[1], p2[1], p3[1]);
+        simd::float_4 x2(p0[2], p1[2], p2[2], p3[2]);
+        simd::float_4 x3(p0[3], p1[3], p2[3], p3[3]);
+        simd::float_4 y = Hermite4pt3oX(x0, x1, x2, x3, simd::float_4(index - i));
+
+        simd::float_4 weights((1 - frame_t) * (1 - level_t), (1 - frame_t) * level_t, frame_t * (1 - level_t), frame_t * level_t);
+        y *= weights;
+        return y[0] + y[1] + y[2] + y[3];
+    }
+
+private:
+
+    int frame_count_ = 0;
+    int level_count_ = 1;
+    std::vector<float> tables_;
+
+    dsp::RealFFT fft_;
+    alignas(16) float input_[TABLE_SIZE];
+    alignas(16) float spectrum_[TABLE_SIZE];
+
+    float *getTable(int frame, int level)
+    {
+        return &tables_[(frame * level_count_ + level) * STRIDE];
+    }
+};
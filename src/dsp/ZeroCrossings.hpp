@@ -0,0 +1,52 @@
+// Sub-sampled zero crossing index. Keeps the first sign change of each BLOCK
+// samples as a one byte offset into the block, 1/512 of the clip's size.
+// Snapping lands on a real crossing, at most a block or two from the nearest.
+struct ZeroCrossings
+{
+    static const int BLOCK = 128;
+    static const int MAX_DISTANCE = 64;  // Blocks searched each way.
+
+    void build(const float *data, int count)
+    {
+        offsets_.assign((count + BLOCK - 1) / BLOCK, (uint8_t)NO_CROSSING);
+        for (int i = 1; i < count; i++)
+            if ((data[i - 1] < 0.0f) != (data[i] < 0.0f) && offsets_[i / BLOCK] == NO_CROSSING)
+                offsets_[i / BLOCK] = i % BLOCK;
+    }
+
+    // Indexed crossing nearest to index. index itself when there is none
+    // within MAX_DISTANCE blocks. O(1).
+    unsigned int getNearest(unsigned int index)
+    {
+        const int blocks = offsets_.size();
+        const int block = index / BLOCK;
+        unsigned int nearest = index;
+        unsigned int nearest_distance = UINT_MAX;
+
+        for (int distance = 0; distance <= MAX_DISTANCE; distance++) {
+            // Every crossing further out is at least this far.
+            if (distance > 0 && (unsigned int)(distance - 1) * BLOCK >= nearest_distance)
+                break;
+
+            const int sides[2] = { block - distance, block + distance };
+            for (int s = 0; s < (distance > 0 ? 2 : 1); s++) {
+                const int b = sides[s];
+                if (b < 0 || b >= blocks || offsets_[b] == NO_CROSSING)
+                    continue;
+
+                const unsigned int crossing = b * BLOCK + offsets_[b];
+                const unsigned int crossing_distance = crossing > index ? crossing - index : index - crossing;
+                if (crossing_distance < nearest_distance) {
+                    nearest = crossing;
+                    nearest_distance = crossing_distance;
+                }
+            }
+        }
+        return nearest;
+    }
+
+private:
+    static const uint8_t NO_CROSSING = 0xff;
+
+    std::vector<uint8_t> offsets_;
+};